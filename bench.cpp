@@ -0,0 +1,156 @@
+// bench.cpp
+// Micro-benchmarks for the thread pool. Build and run with: make bench
+//
+//   submit-to-start  time from enqueue() on an outside thread until the task body
+//                    starts, one task at a time, after the pool has been idle
+//                    for the given gap (0 = back to back)
+//   burst            wall time to run many empty tasks submitted at once
+//   bulk burst       the same tasks submitted with one try_enqueue_bulk call
+//   parallel_reduce  a CPU-bound reduction run serially, then with parallel_reduce
+//   priority         submit-to-start of a Critical task queued behind a flood of
+//                    Background tasks
+
+#include "fire_n_go.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void submit_to_start(util::ThreadPool& pool, std::chrono::microseconds gap, int rounds) {
+    std::vector<long long> samples;
+    samples.reserve(static_cast<size_t>(rounds));
+    std::atomic<bool> done{false};
+    for (int round = 0; round < rounds; ++round) {
+        if (gap.count() > 0) {
+            std::this_thread::sleep_for(gap);
+        }
+        done.store(false, std::memory_order_relaxed);
+        Clock::time_point started;
+        const Clock::time_point submitted = Clock::now();
+        pool.enqueue([&started, &done] {
+            started = Clock::now();
+            done.store(true, std::memory_order_release);
+        });
+        while (!done.load(std::memory_order_acquire)) {
+            std::this_thread::yield(); // Not a sleep, so our own wakeup is not measured.
+        }
+        samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(started - submitted).count());
+    }
+    std::ranges::sort(samples);
+    const auto at = [&samples](double percent) {
+        return samples[static_cast<size_t>(percent / 100.0 * static_cast<double>(samples.size() - 1))] / 1000.0;
+    };
+    std::printf("submit-to-start  gap %5lld us: p50 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+                static_cast<long long>(gap.count()), at(50), at(99), at(100));
+}
+
+void burst(util::ThreadPool& pool, int tasks) {
+    std::atomic<int> remaining{tasks};
+    const Clock::time_point begin = Clock::now();
+    for (int i = 0; i < tasks; ++i) {
+        pool.enqueue([&remaining] { remaining.fetch_sub(1, std::memory_order_release); });
+    }
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::printf("burst            %d tasks: %8.1f ms  (%.2f M tasks/s)\n", tasks, seconds * 1000.0, tasks / seconds / 1e6);
+}
+
+void bulk_burst(util::ThreadPool& pool, int tasks) {
+    std::atomic<int> remaining{tasks};
+    std::vector<util::unique_task> batch;
+    batch.reserve(static_cast<size_t>(tasks));
+    for (int i = 0; i < tasks; ++i) {
+        batch.emplace_back([&remaining] { remaining.fetch_sub(1, std::memory_order_release); });
+    }
+    const Clock::time_point begin = Clock::now();
+    pool.try_enqueue_bulk(batch);
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::printf("bulk burst       %d tasks: %8.1f ms  (%.2f M tasks/s)\n", tasks, seconds * 1000.0, tasks / seconds / 1e6);
+}
+
+void reduce(util::ThreadPool& pool, size_t size) {
+    const auto work = [](size_t i) { return std::sqrt(static_cast<double>(i)); };
+
+    Clock::time_point begin = Clock::now();
+    double serial = 0.0;
+    for (size_t i = 0; i < size; ++i) {
+        serial += work(i);
+    }
+    const double serial_seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    begin = Clock::now();
+    const double parallel = util::parallel_reduce(pool, size_t{0}, size, 4096, 0.0, work, std::plus<>{});
+    const double parallel_seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::printf("parallel_reduce  %zu items: serial %8.1f ms, parallel %8.1f ms  (%.2fx, results differ by %.1e)\n",
+                size, serial_seconds * 1000.0, parallel_seconds * 1000.0, serial_seconds / parallel_seconds,
+                std::abs(serial - parallel) / serial);
+}
+
+void priority_under_load(util::ThreadPool& pool, int background, int rounds) {
+    std::vector<long long> samples;
+    samples.reserve(static_cast<size_t>(rounds));
+    std::atomic<int> remaining{background};
+    for (int i = 0; i < background; ++i) {
+        pool.enqueue([&remaining] {
+            const Clock::time_point until = Clock::now() + std::chrono::microseconds(20);
+            while (Clock::now() < until) {
+            }
+            remaining.fetch_sub(1, std::memory_order_release);
+        }, {.priority = util::Priority::Background});
+    }
+    std::atomic<bool> done{false};
+    for (int round = 0; round < rounds; ++round) {
+        done.store(false, std::memory_order_relaxed);
+        Clock::time_point started;
+        const Clock::time_point submitted = Clock::now();
+        pool.enqueue([&started, &done] {
+            started = Clock::now();
+            done.store(true, std::memory_order_release);
+        }, {.priority = util::Priority::Critical});
+        while (!done.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(started - submitted).count());
+    }
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+    std::ranges::sort(samples);
+    std::printf("priority         critical behind %d background: p50 %8.1f us  p99 %8.1f us\n", background,
+                samples[samples.size() / 2] / 1000.0, samples[samples.size() * 99 / 100] / 1000.0);
+}
+
+} // namespace
+
+int main() {
+    util::ThreadPool pool({.name = "bench"});
+    std::printf("workers: %zu\n", pool.thread_count());
+    for (int gap_us : {0, 20, 200, 2000}) {
+        submit_to_start(pool, std::chrono::microseconds(gap_us), gap_us >= 2000 ? 500 : 5000);
+    }
+    for (int i = 0; i < 3; ++i) {
+        burst(pool, 1'000'000);
+    }
+    for (int i = 0; i < 3; ++i) {
+        bulk_burst(pool, 1'000'000);
+    }
+    for (int i = 0; i < 3; ++i) {
+        reduce(pool, 50'000'000);
+    }
+    priority_under_load(pool, 20'000, 200);
+    return 0;
+}
@@ -0,0 +1,142 @@
+// binary_log.hpp
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstring>      // For std::memcpy
+#include <format>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Binary log file format shared by the deferred-formatting logger
+// (FNGO_BINARY_LOGS) and the fngo_logdecode tool.
+//
+// The file starts with file_magic and continues with a sequence of entries,
+// every integer little-endian (native order on the supported platforms):
+//
+//   Descriptor: u8 kind=1, u32 id, u8 level, u32 area size, area bytes,
+//               u32 format size, format bytes, u8 argument count, u8 ArgType[count]
+//   Record:     u8 kind=2, u32 descriptor id, u64 timestamp (ns since the Unix epoch),
+//               u64 thread id, u32 payload size, payload
+//
+// A descriptor always precedes the first record that refers to it. The payload
+// holds the arguments back to back, encoded as their descriptor's ArgType says:
+// integers and doubles as 8 bytes, bools and chars as 1 byte, strings as a u32
+// size followed by the bytes.
+
+namespace util::log::binary {
+
+inline constexpr char file_magic[8] = {'F', 'N', 'G', 'O', 'L', 'O', 'G', '1'};
+
+// Identifies binary records handed to the asynchronous backend.
+inline constexpr int stream = -1;
+
+enum class EntryKind : uint8_t {
+    Descriptor = 1,
+    Record = 2
+};
+
+enum class ArgType : uint8_t {
+    Int64 = 1,
+    UInt64,
+    Double,
+    Bool,
+    Char,
+    String
+};
+
+// Everything known about a log call site at compile time, plus its file id.
+struct Descriptor {
+    uint32_t id;
+    uint8_t level;
+    const char* format_site; // Address of the format string literal; the cache key.
+    std::string area;
+    std::string format;
+    std::vector<ArgType> args;
+};
+
+// How an argument of type T is stored. Types without a native encoding are
+// formatted with "{}" at the call site and stored as strings.
+template<typename T>
+constexpr ArgType arg_type_of() {
+    using V = std::decay_t<T>;
+    using enum ArgType;
+    if constexpr (std::same_as<V, bool>) {
+        return Bool;
+    } else if constexpr (std::same_as<V, char>) {
+        return Char;
+    } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+        return Int64;
+    } else if constexpr (std::is_integral_v<V>) {
+        return UInt64;
+    } else if constexpr (std::is_floating_point_v<V>) {
+        return Double;
+    } else {
+        return String;
+    }
+}
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+void append(std::string& out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+inline void append_string(std::string& out, std::string_view text) {
+    append(out, static_cast<uint32_t>(text.size()));
+    out.append(text);
+}
+
+template<typename T>
+void encode_arg(std::string& out, const T& value) {
+    using enum ArgType;
+    constexpr ArgType type = arg_type_of<T>();
+    if constexpr (type == Bool || type == Char) {
+        append(out, static_cast<uint8_t>(value));
+    } else if constexpr (type == Int64) {
+        append(out, static_cast<int64_t>(value));
+    } else if constexpr (type == UInt64) {
+        append(out, static_cast<uint64_t>(value));
+    } else if constexpr (type == Double) {
+        append(out, static_cast<double>(value));
+    } else if constexpr (std::convertible_to<const T&, std::string_view>) {
+        append_string(out, std::string_view(value));
+    } else {
+        append_string(out, std::format("{}", value));
+    }
+}
+
+// Appends a complete Record entry to out.
+template<typename... Args>
+void encode_record(std::string& out, uint32_t descriptor, uint64_t thread, const Args&... args) {
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    append(out, static_cast<uint8_t>(EntryKind::Record));
+    append(out, descriptor);
+    append(out, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()));
+    append(out, thread);
+    const size_t size_offset = out.size();
+    append(out, uint32_t{0});
+    (encode_arg(out, args), ...);
+    const auto payload_size = static_cast<uint32_t>(out.size() - size_offset - sizeof(uint32_t));
+    std::memcpy(out.data() + size_offset, &payload_size, sizeof(payload_size));
+}
+
+// Appends a complete Descriptor entry to out.
+inline void encode_descriptor(std::string& out, const Descriptor& descriptor) {
+    append(out, static_cast<uint8_t>(EntryKind::Descriptor));
+    append(out, descriptor.id);
+    append(out, descriptor.level);
+    append_string(out, descriptor.area);
+    append_string(out, descriptor.format);
+    append(out, static_cast<uint8_t>(descriptor.args.size()));
+    for (ArgType type : descriptor.args) {
+        append(out, static_cast<uint8_t>(type));
+    }
+}
+
+} // namespace util::log::binary
@@ -0,0 +1,13 @@
+// cache_line.hpp
+#pragma once
+
+#include <cstddef>
+
+namespace util {
+
+// Used to keep atomics written by different threads on separate cache lines.
+// A fixed value is used instead of std::hardware_destructive_interference_size,
+// which GCC warns about when it appears in headers (its value may change with -mtune).
+inline constexpr std::size_t cache_line_size = 64;
+
+} // namespace util
@@ -0,0 +1,283 @@
+// coroutine.hpp
+#pragma once
+
+#include "fire_n_go.hpp"
+#include "future.hpp"
+#include <coroutine>
+#include <exception>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace util {
+
+/**
+ * @class ScheduleAwaitable
+ * @brief Suspends the awaiting coroutine and resumes it on a pool worker.
+ *
+ * The coroutine handle itself is the queued task: a coroutine_handle is a single
+ * pointer, so it fits unique_task's inline buffer and resuming it involves no
+ * wrapper, no logging and no allocation.
+ */
+class ScheduleAwaitable {
+public:
+    explicit ScheduleAwaitable(ThreadPool* pool) noexcept : m_pool(pool) {}
+
+    // Without a pool there is nowhere to go, so the coroutine simply continues.
+    bool await_ready() const noexcept { return m_pool == nullptr; }
+    void await_suspend(std::coroutine_handle<> continuation) const { m_pool->enqueue(continuation); }
+    void await_resume() const noexcept {}
+
+private:
+    ThreadPool* m_pool;
+};
+
+/**
+ * @brief Like ScheduleAwaitable, but the move onto the pool is a new named task
+ * admitted through ThreadPool::try_enqueue_named: the queue bound and the
+ * name's rate limit apply to it. co_await yields how the pool dealt with it;
+ * unless it was accepted, the coroutine continues on the current thread.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class AdmitAwaitable {
+public:
+    AdmitAwaitable(ThreadPool* pool, std::string_view task_name) noexcept : m_pool(pool), m_task_name(task_name) {}
+
+    bool await_ready() const noexcept { return m_pool == nullptr; }
+    bool await_suspend(std::coroutine_handle<> continuation) {
+        // A coroutine handle cannot be merged into another task, so it is never Mergeable.
+        // Under CallerRuns the coroutine may already have run to completion
+        // inside try_enqueue_named, destroying this awaiter: only touch it on rejection.
+        const EnqueueResult result = m_pool->try_enqueue_named(m_task_name, unique_task(continuation), {}, SubmitKind::Exclusive);
+        if (result == EnqueueResult::Accepted) {
+            return true;
+        }
+        m_result = result;
+        return false;
+    }
+    EnqueueResult await_resume() const noexcept { return m_result; }
+
+private:
+    ThreadPool* m_pool;
+    std::string_view m_task_name;
+    EnqueueResult m_result = EnqueueResult::Accepted;
+};
+
+// co_await util::schedule() moves the current coroutine onto the global thread pool.
+inline ScheduleAwaitable schedule() { return ScheduleAwaitable(get_thread_pool_instance()); }
+inline ScheduleAwaitable schedule(ThreadPool& pool) noexcept { return ScheduleAwaitable(&pool); }
+
+
+template<typename T = void>
+class task;
+
+/**
+ * @brief Promise behaviour shared by every task<T>: stores the result and, on
+ * completion, transfers control straight to the awaiting coroutine.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename T>
+class TaskPromiseBase {
+public:
+    using value_type = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) const noexcept {
+            std::coroutine_handle<> continuation = finished.promise().m_continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { m_result.template emplace<2>(std::current_exception()); }
+
+    void set_continuation(std::coroutine_handle<> continuation) noexcept { m_continuation = continuation; }
+
+    value_type take_result() {
+        if (m_result.index() == 2) {
+            std::rethrow_exception(std::get<2>(m_result));
+        }
+        return std::move(std::get<1>(m_result));
+    }
+
+protected:
+    std::variant<std::monostate, value_type, std::exception_ptr> m_result;
+
+private:
+    std::coroutine_handle<> m_continuation;
+};
+
+// Adds return_value or return_void, whichever applies to T.
+template<typename T>
+class TaskPromiseReturn : public TaskPromiseBase<T> {
+public:
+    template<typename V>
+    void return_value(V&& value) { this->m_result.template emplace<1>(std::forward<V>(value)); }
+};
+
+template<>
+class TaskPromiseReturn<void> : public TaskPromiseBase<void> {
+public:
+    void return_void() noexcept { m_result.emplace<1>(); }
+};
+
+
+/**
+ * @class task
+ * @brief A lazily started coroutine producing a T.
+ *
+ * The body does not run until the task is awaited. Combine with
+ * `co_await util::schedule()` to move onto the pool, with spawn() to run a
+ * task<void> detached, or with sync_wait() to block a non-worker thread on it.
+ */
+template<typename T>
+class [[nodiscard]] task {
+public:
+    struct promise_type : TaskPromiseReturn<T> {
+        task get_return_object() noexcept { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    task(task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) {
+                m_handle.destroy();
+            }
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept {
+                handle.promise().set_continuation(awaiting);
+                return handle; // Symmetric transfer: start the task without growing the stack.
+            }
+            T await_resume() const {
+                if constexpr (std::is_void_v<T>) {
+                    handle.promise().take_result();
+                } else {
+                    return handle.promise().take_result();
+                }
+            }
+        };
+        return Awaiter{m_handle};
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+
+/**
+ * @brief A self-destroying coroutine used to run a task without an owner.
+ *
+ * @note This class is an internal implementation detail.
+ */
+struct DetachedCoroutine {
+    struct promise_type {
+        DetachedCoroutine get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        // Bodies catch everything themselves.
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+// run_time of a coroutine includes the time it spent suspended.
+inline DetachedCoroutine run_detached(ThreadPool* pool, TaskName name, task<void> work) {
+    using enum log::Level;
+    const auto enqueued = TaskClock::now();
+    if (const EnqueueResult admitted = co_await AdmitAwaitable(pool, name.view()); admitted != EnqueueResult::Accepted) {
+        log_rejected_task(*pool, name.view(), admitted);
+        co_return;
+    }
+    const auto started = TaskClock::now();
+    log::print<Info>("TaskRunner", "Starting task: '{}'", name.view());
+    try {
+        co_await std::move(work);
+        log::print<Info>("TaskRunner", "Finished task: '{}'", name.view());
+    } catch (...) {
+        log_task_exception(name.view(), std::current_exception());
+    }
+    pool->record_latency(name.view(), started - enqueued, TaskClock::now() - started);
+}
+
+template<typename T>
+DetachedCoroutine run_into_promise(task<T> work, promise<T> result) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(work);
+            result.set_value();
+        } else {
+            result.set_value(co_await std::move(work));
+        }
+    } catch (...) {
+        result.set_exception(std::current_exception());
+    }
+}
+
+
+/**
+ * @brief Starts a task<void> on the given thread pool without waiting for it.
+ *
+ * The coroutine counterpart of fire_and_forget: it is logged and admitted the
+ * same way, so the pool's queue bound and the name's rate limit apply, and an
+ * exception escaping the coroutine is logged instead of propagated.
+ *
+ * @param pool The pool the coroutine starts on.
+ * @param task_name A descriptive name for the task, used for logging.
+ * @param work The coroutine to run.
+ */
+inline void spawn(ThreadPool& pool, std::string_view task_name, task<void> work) {
+    run_detached(&pool, TaskName(task_name), std::move(work));
+}
+
+// Starts a task<void> on the global thread pool without waiting for it.
+inline void spawn(std::string_view task_name, task<void> work) {
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "spawn called but thread pool is not available.");
+        return;
+    }
+    spawn(*pool_instance, task_name, std::move(work));
+}
+
+
+/**
+ * @brief Runs a task to completion, blocking the calling thread.
+ *
+ * The task starts on the calling thread and continues wherever its awaits take
+ * it. Do not call this from a pool worker: it blocks that worker.
+ */
+template<typename T>
+T sync_wait(task<T> work) {
+    promise<T> result(get_thread_pool_instance());
+    future<T> done = result.get_future();
+    run_into_promise(std::move(work), std::move(result));
+    return done.get();
+}
+
+} // namespace util
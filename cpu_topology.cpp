@@ -0,0 +1,120 @@
+// cpu_topology.cpp
+#include "cpu_topology.hpp"
+#include <algorithm>
+#include <charconv>     // For std::from_chars
+#include <filesystem>
+#include <fstream>
+#include <iterator>     // For std::back_inserter
+#include <string>
+#include <thread>       // For std::thread::hardware_concurrency
+
+#ifdef __linux__
+#include <sched.h>      // For sched_getaffinity and sched_setaffinity
+#endif
+
+namespace util {
+
+namespace { // Anonymous namespace for internal linkage
+
+    bool parse_cpu(std::string_view text, unsigned& cpu) {
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), cpu);
+        return error == std::errc{} && end == text.data() + text.size();
+    }
+
+    // The CPUs this process may run on.
+    std::vector<unsigned> usable_cpus() {
+        std::vector<unsigned> cpus;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+#endif
+        const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < count; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+} // namespace
+
+std::vector<unsigned> parse_cpu_list(std::string_view text) {
+    std::vector<unsigned> cpus;
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) {
+        text.remove_suffix(1);
+    }
+    while (!text.empty()) {
+        const size_t comma = text.find(',');
+        const std::string_view range = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+
+        const size_t dash = range.find('-');
+        unsigned first = 0;
+        unsigned last = 0;
+        if (!parse_cpu(range.substr(0, dash), first)
+            || !parse_cpu(dash == std::string_view::npos ? range : range.substr(dash + 1), last) || last < first) {
+            return {};
+        }
+        for (unsigned cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    std::ranges::sort(cpus);
+    const auto duplicates = std::ranges::unique(cpus);
+    cpus.erase(duplicates.begin(), duplicates.end());
+    return cpus;
+}
+
+std::vector<NumaNode> read_numa_topology() {
+    const std::vector<unsigned> usable = usable_cpus();
+    std::vector<NumaNode> nodes;
+
+    std::error_code error;
+    const std::filesystem::path root = "/sys/devices/system/node";
+    for (const auto& entry : std::filesystem::directory_iterator(root, error)) {
+        const std::string name = entry.path().filename().string();
+        unsigned id = 0;
+        if (!name.starts_with("node") || !parse_cpu(std::string_view(name).substr(4), id)) {
+            continue;
+        }
+        std::ifstream file(entry.path() / "cpulist");
+        std::string text;
+        std::getline(file, text);
+        NumaNode node{id, {}};
+        std::ranges::set_intersection(parse_cpu_list(text), usable, std::back_inserter(node.cpus));
+        if (!node.cpus.empty()) {
+            nodes.push_back(std::move(node));
+        }
+    }
+
+    if (nodes.empty()) {
+        nodes.push_back(NumaNode{0, usable});
+    }
+    std::ranges::sort(nodes, {}, &NumaNode::id);
+    return nodes;
+}
+
+bool pin_current_thread(std::span<const unsigned> cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+} // namespace util
@@ -0,0 +1,41 @@
+// cpu_topology.hpp
+#pragma once
+
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace util {
+
+/**
+ * @brief The CPUs of one NUMA node that this process may run on.
+ */
+struct NumaNode {
+    unsigned id = 0; // As numbered in /sys/devices/system/node.
+    std::vector<unsigned> cpus;
+};
+
+/**
+ * @brief Parses a kernel CPU list such as "0-3,8,10-11".
+ *
+ * @return The listed CPUs in ascending order, or an empty vector if the text is malformed.
+ */
+std::vector<unsigned> parse_cpu_list(std::string_view text);
+
+/**
+ * @brief Reads the NUMA topology from /sys/devices/system/node.
+ *
+ * Only CPUs in the process's affinity mask are listed, and nodes left without
+ * any are omitted. Where the topology cannot be read (not Linux, no sysfs),
+ * every usable CPU is reported as part of a single node 0.
+ */
+std::vector<NumaNode> read_numa_topology();
+
+/**
+ * @brief Restricts the calling thread to the given CPUs.
+ *
+ * @return false if the platform has no affinity API or the kernel refused the mask.
+ */
+bool pin_current_thread(std::span<const unsigned> cpus);
+
+} // namespace util
@@ -1,5 +1,12 @@
 // fire_n_go.cpp
 #include "fire_n_go.hpp"
+#include <cctype>       // For std::isalnum and std::toupper
+#include <charconv>     // For std::from_chars
+#include <cmath>        // For std::isfinite and std::pow
+#include <cstdint>      // For SIZE_MAX
+#include <cstdlib>      // For std::getenv
+#include <algorithm>    // For std::min
+#include <cstring>      // For std::strlen
 #include <memory>
 #include <mutex> // For std::mutex in lazy init
 
@@ -28,6 +35,146 @@ namespace { // Anonymous namespace for internal linkage
     // destructor will now handle the shutdown automatically and safely at the
     // correct time during program termination, preventing the double-free error.
 
+    // Identifies the pool and slot of the worker running on the current thread,
+    // so that submissions from inside a task can use the worker's local deque.
+    struct WorkerIdentity {
+        const ThreadPool* pool = nullptr;
+        size_t index = 0;
+    };
+    thread_local WorkerIdentity current_worker;
+
+    // Per-thread cache of deque nodes. A node is released by whichever thread runs
+    // the task, so a thief's cache absorbs nodes from its victims; the cap keeps
+    // that imbalance from hoarding memory.
+    class TaskNodeCache {
+    public:
+        TaskNodeCache() = default;
+        TaskNodeCache(const TaskNodeCache&) = delete;
+        TaskNodeCache& operator=(const TaskNodeCache&) = delete;
+
+        ~TaskNodeCache() {
+            while (m_head) {
+                delete std::exchange(m_head, m_head->next_free);
+            }
+        }
+
+        ThreadPool::TaskNode* acquire(unique_task&& task) {
+            if (!m_head) {
+                return new ThreadPool::TaskNode{std::move(task)};
+            }
+            ThreadPool::TaskNode* node = std::exchange(m_head, m_head->next_free);
+            --m_count;
+            node->task = std::move(task);
+            return node;
+        }
+
+        void release(ThreadPool::TaskNode* node) {
+            if (m_count == max_cached_nodes) {
+                delete node;
+                return;
+            }
+            node->next_free = m_head;
+            m_head = node;
+            ++m_count;
+        }
+
+    private:
+        static constexpr size_t max_cached_nodes = 1024;
+        ThreadPool::TaskNode* m_head = nullptr;
+        size_t m_count = 0;
+    };
+    thread_local TaskNodeCache node_cache;
+
+    // Moves the task out of a node taken from a deque and recycles the node.
+    unique_task take_task(ThreadPool::TaskNode* node) {
+        unique_task task = std::move(node->task);
+        node_cache.release(node);
+        return task;
+    }
+
+    // A positive integer from the environment, or 0 when unset or malformed.
+    size_t thread_count_from_env(const std::string& variable) {
+        const char* text = std::getenv(variable.c_str());
+        if (!text) {
+            return 0;
+        }
+        size_t count = 0;
+        const char* end = text + std::strlen(text);
+        if (const auto [parsed, error] = std::from_chars(text, end, count); error != std::errc{} || parsed != end) {
+            log::print<log::Level::Warning>("ThreadPool", "Ignoring {}='{}': not a thread count.", variable, text);
+            return 0;
+        }
+        return count;
+    }
+
+    // Applies the PoolOptions::threads fallbacks.
+    size_t resolve_thread_count(const PoolOptions& options) {
+        if (options.threads != 0) {
+            return options.threads;
+        }
+        std::string variable = "FNGO_THREADS_";
+        for (char c : options.name) {
+            variable.push_back(std::isalnum(static_cast<unsigned char>(c)) ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : '_');
+        }
+        size_t count = thread_count_from_env(variable);
+        if (count == 0) {
+            count = thread_count_from_env("FNGO_THREADS");
+        }
+        if (count == 0) {
+            count = std::thread::hardware_concurrency();
+        }
+        return count != 0 ? count : 2; // Fallback
+    }
+
+    // Lets a sibling hyperthread run while we spin.
+    inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // Low bit of ThreadPool::m_wake_epoch: a worker has been woken and has not
+    // started looking for work yet. Producers do not wake another one meanwhile,
+    // which keeps a burst of submits from making a system call each.
+    constexpr uint32_t wake_pending = 1;
+
+    // An idle worker polls for work spin_rounds times, pausing in between,
+    // for a few microseconds in total, before it parks.
+    constexpr int spin_rounds = 64;
+    constexpr int pauses_per_spin_round = 32;
+
+    // A producer facing a full bounded injection queue retries this many
+    // times, yielding in between. After that a worker of the pool runs the
+    // task itself, since every worker could be stuck the same way with no one
+    // left to make room; any other thread keeps waiting, but sleeps between tries.
+    constexpr size_t full_queue_spins = 256;
+    constexpr std::chrono::microseconds full_queue_backoff{50};
+
+    // Between two tries at a full injection queue.
+    void wait_for_room(size_t tries) {
+        if (tries < full_queue_spins) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(full_queue_backoff);
+        }
+    }
+
+    // Cheap per-worker pseudo-random generator for picking steal victims.
+    std::uint64_t next_random(std::uint64_t& state) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // Victim picker of threads outside any pool that help through run_pending_task().
+    thread_local std::uint64_t helper_rng_state = 0x2545F4914F6CDD1Dull;
+
+    // Draws retry jitter; seeded per thread so that threads do not draw in step.
+    thread_local std::uint64_t jitter_rng_state = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+
 } // namespace
 
 // --- Public function to access the pool ---
@@ -42,57 +189,1057 @@ ThreadPool* get_thread_pool_instance() {
         // another thread might have initialized the pool while we were waiting for the lock.
         if (!get_pool_instance_ptr()) {
             using enum log::Level;
-            size_t num_threads = std::thread::hardware_concurrency();
-            if (num_threads == 0) num_threads = 2; // Fallback
-            get_pool_instance_ptr() = std::make_unique<ThreadPool>(num_threads);
-            log::print<Info>("ThreadPool", "Lazy initialization: Thread pool created with {} threads.", num_threads);
+            get_pool_instance_ptr() = std::make_unique<ThreadPool>(PoolOptions{
+                .max_threads = FNGO_MAX_THREADS,
+                .max_queued_tasks = FNGO_MAX_QUEUED_TASKS,
+                .overflow = OverflowPolicy::FNGO_OVERFLOW_POLICY});
+            log::print<Info>("ThreadPool", "Lazy initialization: Thread pool created with {} threads.",
+                             get_pool_instance_ptr()->thread_count());
         }
     }
     return get_pool_instance_ptr().get();
 }
 
 
+// --- RetryPolicy Method Implementations ---
+
+TaskClock::duration RetryPolicy::backoff(unsigned attempts) const {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    const double exponent = attempts == 0 ? 0.0 : static_cast<double>(attempts - 1);
+    double wait = std::min(static_cast<double>(initial_backoff.count()) * std::pow(multiplier, exponent),
+                           static_cast<double>(max_backoff.count()));
+    const double random_fraction = static_cast<double>(next_random(jitter_rng_state) >> 11) * 0x1.0p-53;
+    wait *= 1.0 - std::clamp(jitter, 0.0, 1.0) * random_fraction;
+    return std::chrono::duration_cast<TaskClock::duration>(Milliseconds(std::max(wait, 0.0)));
+}
+
+bool RetryPolicy::should_retry(const std::exception_ptr& error) const {
+    using enum log::Level;
+    if (retry_if) {
+        try {
+            return retry_if(error);
+        } catch (...) {
+            log::print<Error>("TaskRunner", "A retry_if rule threw; the task is not retried.");
+            return false;
+        }
+    }
+    try {
+        std::rethrow_exception(error);
+    } catch (const TaskFailure&) {
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+void RetryPolicy::give_up(DeadLetter letter) const {
+    using enum log::Level;
+    if (!on_dead_letter) {
+        log::print<Error>("TaskRunner", "Gave up on task '{}' after {} attempt(s).", letter.task_name, letter.attempts);
+        return;
+    }
+    const std::string task_name = letter.task_name; // The handler takes the letter.
+    try {
+        on_dead_letter(std::move(letter));
+    } catch (const std::exception& e) {
+        const char* error_what = e.what();
+        log::print<Error>("TaskRunner", "The dead-letter handler failed for task '{}': {}", task_name, error_what);
+    } catch (...) {
+        log::print<Error>("TaskRunner", "The dead-letter handler failed for task '{}' with an unknown exception.", task_name);
+    }
+}
+
+
 // --- ThreadPool Method Implementations ---
 
-ThreadPool::ThreadPool(size_t num_threads) {
-    start(num_threads);
+ThreadPool::ThreadPool(PoolOptions options)
+    : m_options(std::move(options)),
+      // With one core, a spinning worker only delays the producer it is waiting for.
+      m_by_deadline(m_options.discipline == QueueDiscipline::EarliestDeadline),
+      m_spin_when_idle(m_options.spin_when_idle && std::thread::hardware_concurrency() > 1) {
+    using enum log::Level;
+    for (const RateLimit& limit : m_options.rate_limits) {
+        if (!(limit.per_second > 0.0) || !std::isfinite(limit.per_second)) {
+            log::print<Warning>("ThreadPool", "Ignoring the rate limit of '{}' on the '{}' pool: {} per second is not a positive rate.",
+                                limit.task_name, m_options.name, limit.per_second);
+        } else if (!m_rate_limiters.try_emplace(limit.task_name, limit).second) {
+            log::print<Warning>("ThreadPool", "Ignoring a second rate limit of '{}' on the '{}' pool.", limit.task_name, m_options.name);
+        }
+    }
+    start(resolve_thread_count(m_options));
 }
 
+
 ThreadPool::~ThreadPool() {
     // This destructor is now correctly called once by the unique_ptr at program exit.
     using enum log::Level;
-    log::print<Info>("ThreadPool", "ThreadPool destructor called. Shutting down threads...");
-    m_stop_source.request_stop();
-    m_condition.notify_all();
-    // jthreads in m_workers will be automatically joined here.
+    log::print<Info>("ThreadPool", "ThreadPool '{}' destructor called. Shutting down threads...", m_options.name);
+    // Without an earlier shutdown(), whatever is still queued is discarded.
+    shutdown(ShutdownMode::CancelPending);
+}
+
+size_t ThreadPool::shutdown(ShutdownMode mode, TaskClock::duration timeout) {
+    using enum log::Level;
+    if (current_worker_state()) {
+        log::print<Error>("ThreadPool", "shutdown() was called from a worker of the '{}' pool, which would wait for itself; ignored.", m_options.name);
+        return 0;
+    }
+    {
+        const std::scoped_lock lock(m_shutdown_mutex);
+        if (std::exchange(m_shut_down, true)) {
+            return 0;
+        }
+    }
+    m_closed.store(true, std::memory_order_relaxed);
+    // Producers blocked on a full queue give up now rather than push after the final discard.
+    m_slot_epoch.fetch_add(1, std::memory_order_release);
+    m_slot_epoch.notify_all();
+    {
+        // Workers may still schedule timers (e.g. a retry) while we drain; from
+        // here on they are refused instead of restarting the timer thread.
+        const std::scoped_lock lock(m_timer_mutex);
+        m_timers_stopped = true;
+    }
+    // No more timers fire once the timer thread is gone. Pending ones are
+    // dropped now rather than with the pool, so that whatever their triggers
+    // hold (e.g. a retry, which then reaches its dead-letter handler) is released here.
+    m_timer_thread.request_stop();
+    if (m_timer_thread.joinable()) {
+        m_timer_thread.join();
+    }
+    const size_t dropped_timers = m_timers->clear();
+    // Their timers went with the rest, so held tasks are released by hand: a
+    // drain queues them now, ahead of starting vacant workers below.
+    std::map<uint64_t, HeldTask> held;
+    {
+        const std::scoped_lock lock(m_timer_mutex);
+        held.swap(m_held_tasks);
+    }
+    size_t dropped_held = 0;
+    if (mode != ShutdownMode::CancelPending) {
+        for (auto& [id, entry] : held) {
+            submit(std::move(entry.task), entry.options);
+        }
+    } else {
+        dropped_held = held.size();
+    }
+    held.clear();
+
+    if (mode != ShutdownMode::CancelPending) {
+        const auto now = TaskClock::now();
+        const bool bounded = mode == ShutdownMode::DrainUntilDeadline && timeout < TaskClock::time_point::max() - now;
+        // With resize() gone along with the timer thread, vacant slots are ours to fill.
+        for (size_t i = 0; i < m_worker_states.size() && has_queued_tasks(); ++i) {
+            if (m_worker_states[i]->slot == WorkerState::Slot::Vacant) {
+                start_worker(i);
+            }
+        }
+        m_draining.store(true, std::memory_order_relaxed);
+        // As in stop_workers: a worker reads the epoch before checking m_draining.
+        m_wake_epoch.fetch_add(2, std::memory_order_release);
+        m_wake_epoch.notify_all();
+
+        std::unique_lock lock(m_shutdown_mutex);
+        if (bounded) {
+            m_worker_exited.wait_until(lock, now + timeout, [this] { return all_workers_exited(); });
+        } else {
+            m_worker_exited.wait(lock, [this] { return all_workers_exited(); });
+        }
+    }
+
+    stop_workers();
+    // One that got its slot just before admission closed may still be pushing its task.
+    while (m_blocked_producers.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+    const size_t dropped = discard_queued_tasks() + dropped_held + dropped_timers;
+    if (dropped > 0) {
+        log::print<Warning>("ThreadPool", "ThreadPool '{}' shut down; {} task(s) were dropped without running.", m_options.name, dropped);
+    } else {
+        log::print<Info>("ThreadPool", "ThreadPool '{}' shut down with no task left behind.", m_options.name);
+    }
+    return dropped;
+}
+
+// Whether a draining worker that found no task may exit: no other worker is
+// inside a task that could still queue more work.
+bool ThreadPool::drained() const {
+    if (!m_draining.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    for (const auto& state : m_worker_states) {
+        if (state->progress.load(std::memory_order_relaxed) % 2 == 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// With m_shutdown_mutex held, so that a worker's exit cannot slip between the check and the wait.
+bool ThreadPool::all_workers_exited() const {
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        if (m_workers[i].joinable() && !m_worker_states[i]->exited.load(std::memory_order_acquire)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Stops every worker once its current task is done, and joins it.
+void ThreadPool::stop_workers() {
+    m_stop_source.request_stop(); // First, so that a stopping worker does not hand its deque back.
+    for (std::jthread& worker : m_workers) {
+        worker.request_stop();
+    }
+    // A worker reads the epoch before checking for stop, so it cannot miss this.
+    m_wake_epoch.fetch_add(2, std::memory_order_release); // Leaves the wake_pending bit alone.
+    m_wake_epoch.notify_all();
+    for (std::jthread& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+// Destroys every task still queued and returns how many there were. Runs once
+// the workers are gone. Destroying a task can queue another (a broken promise
+// schedules its continuation), so this repeats until the queues stay empty.
+size_t ThreadPool::discard_queued_tasks() {
+    size_t dropped = 0;
+    for (size_t found = 1; found != 0; dropped += found) {
+        found = 0;
+        unique_task task;
+        TaskClock::time_point deadline;
+        for (InjectionQueue& queue : m_tasks) {
+            for (; queue.try_pop(task); task.reset()) {
+                ++found;
+            }
+        }
+        for (const auto& queue : m_node_tasks) {
+            for (; queue->try_pop(task); task.reset()) {
+                ++found;
+            }
+        }
+        for (; m_deadline_tasks.try_pop(task, deadline); task.reset()) {
+            ++found;
+        }
+        for (const auto& state : m_worker_states) {
+            while (auto node = state->local_tasks.pop()) {
+                delete *node;
+                ++found;
+            }
+        }
+    }
+    return dropped;
 }
 
 void ThreadPool::start(size_t num_threads) {
-    m_workers.reserve(num_threads);
+    // Every slot an elastic pool may need is set up front, so the slot vectors
+    // never change while workers and thieves index into them.
+    m_min_workers = num_threads;
+    const size_t slots = std::max(num_threads, m_options.max_threads);
+    m_worker_states.reserve(slots);
+    for (size_t i = 0; i < slots; ++i) {
+        auto state = std::make_unique<WorkerState>();
+        state->rng_state = 0x9E3779B97F4A7C15ull * (i + 1); // Any non-zero seed works for xorshift.
+        m_worker_states.push_back(std::move(state));
+    }
+    place_workers();
+
+    m_workers.resize(slots);
     for (size_t i = 0; i < num_threads; ++i) {
-        m_workers.emplace_back([this](std::stop_token stoken) {
-            worker_loop(std::move(stoken));
-        }, m_stop_source.get_token());
+        start_worker(i);
+    }
+    if (slots > num_threads) {
+        const auto interval = std::max(std::chrono::milliseconds(1), std::min(m_options.grow_after, m_options.blocked_after) / 2);
+        schedule_timer(interval, interval, [this] { resize(); });
     }
 }
 
-void ThreadPool::worker_loop(std::stop_token stoken) {
-    while (!stoken.stop_requested()) {
-        std::function<void()> task;
-        {
-            std::unique_lock lock(m_queue_mutex);
-            m_condition.wait(lock, [this, &stoken] {
-                return stoken.stop_requested() || !m_tasks.empty();
+void ThreadPool::start_worker(size_t index) {
+    WorkerState& state = *m_worker_states[index];
+    state.exited.store(false, std::memory_order_relaxed);
+    state.slot = WorkerState::Slot::Running;
+    state.seen_progress = state.progress.load(std::memory_order_relaxed);
+    state.seen_at = TaskClock::now();
+    m_live_workers.fetch_add(1, std::memory_order_relaxed);
+    // The worker watches its own jthread's stop_token, so it can be retired alone.
+    m_workers[index] = std::jthread([this, index](std::stop_token stoken) {
+        worker_loop(std::move(stoken), index);
+    });
+}
+
+// Runs on the timer thread. Grows the pool while work queues up behind busy
+// or blocked workers and retires extra workers that have been idle too long.
+void ThreadPool::resize() {
+    using enum log::Level;
+    using Slot = WorkerState::Slot;
+    const auto now = TaskClock::now();
+    size_t blocked = 0;
+    size_t vacant = SIZE_MAX;
+    size_t idle = SIZE_MAX; // Highest running slot idle for keep_alive.
+    for (size_t i = 0; i < m_worker_states.size(); ++i) {
+        WorkerState& state = *m_worker_states[i];
+        if (state.slot == Slot::Retiring && state.exited.load(std::memory_order_acquire)) {
+            m_workers[i].join();
+            state.slot = Slot::Vacant;
+        }
+        if (state.slot == Slot::Vacant) {
+            vacant = std::min(vacant, i);
+            continue;
+        }
+        if (state.slot != Slot::Running) {
+            continue;
+        }
+        const uint64_t progress = state.progress.load(std::memory_order_relaxed);
+        if (progress != state.seen_progress) {
+            state.seen_progress = progress;
+            state.seen_at = now;
+        }
+        if (progress % 2 == 1) {
+            blocked += now - state.seen_at >= m_options.blocked_after ? 1 : 0;
+        } else if (now - state.seen_at >= m_options.keep_alive) {
+            idle = i;
+        }
+    }
+
+    const size_t live = m_live_workers.load(std::memory_order_relaxed);
+    const bool queued = has_queued_tasks();
+    // Nobody is free to take the queued work.
+    if (queued && m_sleepers.load(std::memory_order_relaxed) == 0 && m_spinners.load(std::memory_order_relaxed) == 0) {
+        m_saturated_since = m_saturated_since.value_or(now);
+    } else {
+        m_saturated_since.reset();
+    }
+    const bool starved = m_saturated_since && now - *m_saturated_since >= m_options.grow_after;
+    const bool compensate = queued && blocked > 0 && live - blocked < m_min_workers;
+
+    if ((starved || compensate) && vacant != SIZE_MAX) {
+        start_worker(vacant);
+        m_saturated_since.reset();
+        log::print<Debug>("ThreadPool", "Pool '{}' grew to {} workers ({}).", m_options.name, live + 1,
+                          compensate ? "compensating for blocked workers" : "tasks are waiting");
+    } else if (!queued && idle != SIZE_MAX && live > m_min_workers) {
+        WorkerState& state = *m_worker_states[idle];
+        state.slot = Slot::Retiring;
+        m_live_workers.fetch_sub(1, std::memory_order_relaxed);
+        m_workers[idle].request_stop();
+        // A parked worker only notices its stop request once woken.
+        m_wake_epoch.fetch_add(2, std::memory_order_release);
+        m_wake_epoch.notify_all();
+        log::print<Debug>("ThreadPool", "Pool '{}' shrank to {} workers.", m_options.name, live - 1);
+    }
+}
+
+// Spreads the workers over the allowed CPUs, node by node, in proportion to
+// each node's share of them, and gives every node with workers its own queue.
+void ThreadPool::place_workers() {
+    using enum log::Level;
+    if (m_options.affinity == Affinity::None) {
+        return;
+    }
+    std::vector<NumaNode> nodes = read_numa_topology();
+    if (!m_options.cpus.empty()) {
+        for (NumaNode& node : nodes) {
+            std::erase_if(node.cpus, [this](unsigned cpu) { return std::ranges::find(m_options.cpus, cpu) == m_options.cpus.end(); });
+        }
+        std::erase_if(nodes, [](const NumaNode& node) { return node.cpus.empty(); });
+        if (nodes.empty()) {
+            log::print<Warning>("ThreadPool", "None of the CPUs requested for the '{}' pool is usable; its workers are not pinned.", m_options.name);
+            return;
+        }
+    }
+
+    // Node-major list of (node, CPU) pairs; worker i takes an evenly spaced one.
+    std::vector<std::pair<size_t, unsigned>> slots;
+    for (size_t node = 0; node < nodes.size(); ++node) {
+        for (unsigned cpu : nodes[node].cpus) {
+            slots.emplace_back(node, cpu);
+        }
+    }
+    std::vector<size_t> pool_node(nodes.size(), SIZE_MAX); // Topology index to pool index.
+    m_node_ids.clear();
+    const size_t count = m_worker_states.size();
+    for (size_t i = 0; i < count; ++i) {
+        const auto [node, cpu] = slots[i * slots.size() / count];
+        if (pool_node[node] == SIZE_MAX) {
+            pool_node[node] = m_node_ids.size();
+            m_node_ids.push_back(nodes[node].id);
+        }
+        WorkerState& state = *m_worker_states[i];
+        state.node = pool_node[node];
+        state.cpus = m_options.affinity == Affinity::Core ? std::vector<unsigned>{cpu} : nodes[node].cpus;
+    }
+    if (m_node_ids.size() > 1) {
+        for (size_t node = 0; node < m_node_ids.size(); ++node) {
+            m_node_tasks.push_back(std::make_unique<InjectionQueue>());
+        }
+    }
+    log::print<Info>("ThreadPool", "Pinned the workers of the '{}' pool over {} NUMA node(s).", m_options.name, m_node_ids.size());
+}
+
+// Index of a NUMA node id among the pool's nodes, or SIZE_MAX if the pool
+// keeps no queue for it.
+size_t ThreadPool::node_index(int node) const {
+    if (node < 0 || m_node_tasks.empty()) {
+        return SIZE_MAX;
+    }
+    const auto found = std::ranges::find(m_node_ids, static_cast<unsigned>(node));
+    return found == m_node_ids.end() ? SIZE_MAX : static_cast<size_t>(found - m_node_ids.begin());
+}
+
+// The injection queue for a task that does not go to a worker's own deque.
+InjectionQueue& ThreadPool::queue_for(const TaskOptions& options) {
+    if (options.priority == Priority::Normal) {
+        if (const size_t node = node_index(options.node); node != SIZE_MAX) {
+            return *m_node_tasks[node];
+        }
+    }
+    return m_tasks[static_cast<size_t>(options.priority)];
+}
+
+// The calling worker's state if the task may go to its deque, else nullptr.
+ThreadPool::WorkerState* ThreadPool::local_deque_for(const TaskOptions& options) const {
+    if (m_by_deadline || options.priority != Priority::Normal) {
+        return nullptr;
+    }
+    WorkerState* self = current_worker_state();
+    if (self) {
+        const size_t node = node_index(options.node);
+        if (node != SIZE_MAX && node != self->node) {
+            return nullptr;
+        }
+    }
+    return self;
+}
+
+EnqueueResult ThreadPool::try_enqueue_named(std::string_view task_name, unique_task&& task, const TaskOptions& options, SubmitKind kind) {
+    using enum EnqueueResult;
+    RateLimiter* limiter = rate_limiter(task_name);
+    Coalesce mode = Coalesce::None;
+    if (kind == SubmitKind::Mergeable) {
+        mode = options.coalesce;
+        if (limiter && limiter->policy() == RateLimitPolicy::Coalesce && mode == Coalesce::None) {
+            mode = Coalesce::KeepLast;
+        }
+    }
+    // Whichever task loses a merge is left in `task`, for the caller to destroy outside the coalescer's lock.
+    std::shared_ptr<TaskCoalescer::Entry> entry;
+    if (mode != Coalesce::None) {
+        entry = m_coalescer.add(task_name, task, mode);
+        if (!entry) {
+            log::print<log::Level::Debug>("TaskRunner", "Task '{}' was merged into a queued one.", task_name);
+            return Accepted;
+        }
+        task = unique_task(CoalescedRun(m_coalescer, entry));
+    }
+    const EnqueueResult result = [&] {
+        if (limiter) {
+            // Merged tasks never get here, so they take no token.
+            const auto now = TaskClock::now();
+            const auto start = limiter->acquire(now, limiter->policy() != RateLimitPolicy::Reject);
+            if (!start) {
+                return RateLimited;
+            }
+            if (*start > now) {
+                return try_enqueue_after(*start - now, std::move(task), options) ? Accepted : Rejected;
+            }
+        }
+        if (kind == SubmitKind::Continuation) {
+            submit(std::move(task), options);
+            return Accepted;
+        }
+        return try_submit(std::move(task), options) ? Accepted : Rejected;
+    }();
+    if (entry) {
+        if (result == Accepted) {
+            // Only now may other submissions merge into it.
+            m_coalescer.publish(*entry);
+        } else {
+            // Removes the entry, which nothing was merged into, right away.
+            task.reset();
+        }
+    }
+    return result;
+}
+
+bool ThreadPool::try_enqueue_after(TaskClock::duration delay, unique_task&& task, const TaskOptions& options) {
+    if (!m_closed.load(std::memory_order_relaxed) || current_worker_state()) {
+        const std::scoped_lock lock(m_timer_mutex);
+        if (!m_timers_stopped) {
+            // The task waits in m_held_tasks rather than in the trigger, where shutdown() can reach it.
+            const uint64_t id = m_next_held_id++;
+            m_held_tasks.emplace(id, HeldTask{std::move(task), options});
+            add_timer(delay, TaskClock::duration::zero(), [this, id] { release_held_task(id); });
+            return true;
+        }
+    }
+    // Destroyed here, outside the lock, so that a retry reaches its dead-letter handler right away.
+    const unique_task rejected(std::move(task));
+    return false;
+}
+
+TimerHandle ThreadPool::schedule_timer(TaskClock::duration delay, TaskClock::duration period, unique_task trigger, bool carries_task) {
+    const std::scoped_lock lock(m_timer_mutex);
+    if (m_timers_stopped) {
+        return {};
+    }
+    return add_timer(delay, period, std::move(trigger), carries_task);
+}
+
+void ThreadPool::release_held_task(uint64_t id) {
+    HeldTask held;
+    {
+        const std::scoped_lock lock(m_timer_mutex);
+        const auto found = m_held_tasks.find(id);
+        if (found == m_held_tasks.end()) {
+            return;
+        }
+        held = std::move(found->second);
+        m_held_tasks.erase(found);
+    }
+    enqueue(std::move(held.task), held.options);
+}
+
+// With m_timer_mutex held and the timers not stopped.
+TimerHandle ThreadPool::add_timer(TaskClock::duration delay, TaskClock::duration period, unique_task&& trigger, bool carries_task) {
+    if (!m_timer_thread.joinable()) {
+        m_timer_thread = std::jthread([timers = m_timers](std::stop_token stoken) { timers->run(std::move(stoken)); });
+    }
+    return TimerHandle(m_timers, m_timers->add(delay, period, std::move(trigger), carries_task));
+}
+
+ThreadPool::WorkerState* ThreadPool::current_worker_state() const {
+    return current_worker.pool == this ? m_worker_states[current_worker.index].get() : nullptr;
+}
+
+void ThreadPool::submit(unique_task&& task, const TaskOptions& options) {
+    task.mark_continuation();
+    if (m_options.max_queued_tasks != 0) {
+        m_queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    push_task(std::move(task), options);
+}
+
+bool ThreadPool::try_submit(unique_task&& task, const TaskOptions& options) {
+    using enum OverflowPolicy;
+    if (m_closed.load(std::memory_order_relaxed) && !current_worker_state()) {
+        return false;
+    }
+    if (m_options.max_queued_tasks != 0 && reserve_slots(1) == 0) {
+        switch (m_options.overflow) {
+            case FailFast:
+                return false;
+            case CallerRuns:
+                task();
+                return true;
+            case DropOldest:
+                // The new task takes over the dropped task's slot.
+                if (!drop_oldest_task()) {
+                    return false;
+                }
+                break;
+            case Block:
+                // A worker waiting for its own pool to drain could wait forever.
+                if (current_worker_state()) {
+                    task();
+                    return true;
+                }
+                return push_when_slot_frees(std::move(task), options);
+        }
+    }
+    push_task(std::move(task), options);
+    return true;
+}
+
+// Reserves up to `wanted` queue slots in one step and returns how many it got.
+size_t ThreadPool::reserve_slots(size_t wanted) {
+    size_t queued = m_queued.load(std::memory_order_relaxed);
+    size_t granted;
+    do {
+        if (queued >= m_options.max_queued_tasks) {
+            return 0;
+        }
+        granted = std::min(wanted, m_options.max_queued_tasks - queued);
+    } while (!m_queued.compare_exchange_weak(queued, queued + granted, std::memory_order_seq_cst, std::memory_order_relaxed));
+    return granted;
+}
+
+// Waits for a free queue slot and queues the task in it, or returns false once
+// shutdown() has closed the pool. The producer counts as blocked until its task
+// is queued, so that shutdown() can wait for it before the final discard.
+bool ThreadPool::push_when_slot_frees(unique_task&& task, const TaskOptions& options) {
+    // Pairs with release_slot: either we see the freed slot or it sees us blocked.
+    m_blocked_producers.fetch_add(1, std::memory_order_seq_cst);
+    bool reserved = false;
+    for (uint32_t epoch = m_slot_epoch.load(std::memory_order_acquire);
+         !m_closed.load(std::memory_order_relaxed) && !(reserved = reserve_slots(1) == 1);
+         epoch = m_slot_epoch.load(std::memory_order_acquire)) {
+        if (m_queued.load(std::memory_order_seq_cst) >= m_options.max_queued_tasks) {
+            m_slot_epoch.wait(epoch, std::memory_order_acquire);
+        }
+    }
+    if (reserved) {
+        push_task(std::move(task), options);
+    }
+    m_blocked_producers.fetch_sub(1, std::memory_order_release);
+    return reserved;
+}
+
+void ThreadPool::release_slot() {
+    if (m_options.max_queued_tasks == 0) {
+        return;
+    }
+    m_queued.fetch_sub(1, std::memory_order_seq_cst);
+    if (m_blocked_producers.load(std::memory_order_seq_cst) > 0) {
+        m_slot_epoch.fetch_add(1, std::memory_order_release);
+        m_slot_epoch.notify_one();
+    }
+}
+
+// Drops the oldest task of the lowest non-empty priority level or, by
+// deadline, the task with the most time to spare. Continuations (see
+// enqueue) are passed over and queued again, behind newer tasks. The dropped
+// task's queue slot is not released: the caller's new task takes it over, so
+// no blocked producer can grab it in between. Returns false if no other task
+// turned up.
+bool ThreadPool::drop_oldest_task() {
+    // Bounds the work of a full pool whose queues hold mostly continuations.
+    constexpr size_t max_passed_over = 64;
+    unique_task oldest;
+    std::vector<std::pair<unique_task, Priority>> passed_over;
+    // Takes tasks from one queue until one of them may be dropped.
+    const auto take_from = [&](Priority level, auto&& pop) {
+        unique_task task;
+        while (passed_over.size() < max_passed_over && pop(task)) {
+            if (!task.is_continuation()) {
+                oldest = std::move(task);
+                return true;
+            }
+            passed_over.emplace_back(std::move(task), level);
+        }
+        return false;
+    };
+    if (m_by_deadline) {
+        m_deadline_tasks.try_pop_latest(oldest, [](const unique_task& task) { return !task.is_continuation(); });
+    }
+    for (size_t level = priority_count; level-- > 0 && !oldest && !m_by_deadline;) {
+        const auto priority = static_cast<Priority>(level);
+        if (take_from(priority, [&](unique_task& task) { return m_tasks[level].try_pop(task); }) || priority != Priority::Normal) {
+            continue;
+        }
+        for (size_t i = 0; i < m_node_tasks.size() && !oldest; ++i) {
+            take_from(priority, [&](unique_task& task) { return m_node_tasks[i]->try_pop(task); });
+        }
+        for (size_t i = 0; i < m_worker_states.size() && !oldest; ++i) {
+            take_from(priority, [&](unique_task& task) {
+                if (auto stolen = m_worker_states[i]->local_tasks.steal()) {
+                    task = take_task(*stolen);
+                    return true;
+                }
+                return false;
             });
+        }
+    }
+    // Still counted in m_queued, so they go back without a slot of their own.
+    for (auto& [task, priority] : passed_over) {
+        push_task(std::move(task), {.priority = priority});
+    }
+    if (!oldest) {
+        return false;
+    }
+    log::print<log::Level::Warning>("ThreadPool", "Queue is full: dropped the oldest queued task.");
+    // Destroying the task here discards it; a submit() future reports broken_promise.
+    return true;
+}
+
+size_t ThreadPool::try_submit_bulk(std::span<unique_task> tasks, const TaskOptions& options) {
+    if (m_closed.load(std::memory_order_relaxed) && !current_worker_state()) {
+        return 0;
+    }
+    // Whatever fits is reserved and published in one step; the overflow policy
+    // then applies to the remaining tasks one at a time.
+    const size_t admitted = m_options.max_queued_tasks != 0 ? reserve_slots(tasks.size()) : tasks.size();
+    push_bulk(tasks.first(admitted), options);
+
+    size_t accepted = admitted;
+    for (unique_task& task : tasks.subspan(admitted)) {
+        accepted += try_submit(std::move(task), options) ? 1 : 0;
+    }
+    return accepted;
+}
+
+void ThreadPool::push_bulk(std::span<unique_task> tasks, const TaskOptions& options) {
+    if (tasks.empty()) {
+        return;
+    }
+    WorkerState* self = local_deque_for(options);
+    if (m_by_deadline) {
+        m_deadline_tasks.push_bulk(tasks, options.deadline, static_cast<unsigned>(options.priority));
+    } else if (self) {
+        for (unique_task& task : tasks) {
+            self->local_tasks.push(node_cache.acquire(std::move(task)));
+        }
+    } else {
+        InjectionQueue& queue = queue_for(options);
+        size_t pushed = 0;
+        for (size_t tries = 0; (pushed += queue.try_push_bulk(tasks.subspan(pushed))) < tasks.size(); ++tries) {
+            // Only a bounded backend can be full: make sure nobody sleeps on it and back off.
+            if (tries == full_queue_spins && current_worker_state()) {
+                for (unique_task& task : tasks.subspan(pushed)) {
+                    release_slot();
+                    task();
+                }
+                break;
+            }
+            wake_one_worker();
+            wait_for_room(tries);
+        }
+    }
 
-            if (stoken.stop_requested() && m_tasks.empty()) {
+    // As in push_task, but wake as many sleepers as there are tasks to take.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const size_t spinners = m_spinners.load(std::memory_order_relaxed);
+    const size_t wanted = tasks.size() > spinners ? tasks.size() - spinners : 0;
+    wake_workers(std::min(wanted, m_sleepers.load(std::memory_order_relaxed)));
+}
+
+void ThreadPool::push_task(unique_task&& task, const TaskOptions& options) {
+    WorkerState* self = local_deque_for(options);
+    if (m_by_deadline) {
+        m_deadline_tasks.push(std::move(task), options.deadline, static_cast<unsigned>(options.priority));
+    } else if (self) {
+        self->local_tasks.push(node_cache.acquire(std::move(task)));
+    } else {
+        InjectionQueue& queue = queue_for(options);
+        for (size_t tries = 0; !queue.try_push(std::move(task)); ++tries) {
+            // Only a bounded backend can be full: make sure nobody sleeps on it and back off.
+            if (tries == full_queue_spins && current_worker_state()) {
+                release_slot();
+                task();
                 return;
             }
+            wake_one_worker();
+            wait_for_room(tries);
+        }
+    }
+
+    // Pairs with the fence in park(): either the sleeper sees the task or we see the sleeper.
+    // A spinning worker will find the task by itself.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleepers.load(std::memory_order_relaxed) > 0 && m_spinners.load(std::memory_order_relaxed) == 0) {
+        wake_one_worker();
+    }
+}
+
+void ThreadPool::wake_one_worker() {
+    uint32_t epoch = m_wake_epoch.load(std::memory_order_relaxed);
+    while ((epoch & wake_pending) == 0) {
+        if (m_wake_epoch.compare_exchange_weak(epoch, epoch | wake_pending, std::memory_order_release, std::memory_order_relaxed)) {
+            m_wake_epoch.notify_one();
+            return;
+        }
+    }
+    // A woken worker has not started looking for work yet; it will find ours too.
+}
 
-            task = std::move(m_tasks.front());
-            m_tasks.pop();
+void ThreadPool::wake_workers(size_t count) {
+    if (count <= 1) {
+        if (count == 1) {
+            wake_one_worker();
+        }
+        return;
+    }
+    // Every parked worker waits on the current epoch, so moving it lets
+    // each notify_one below release one of them.
+    m_wake_epoch.fetch_add(2, std::memory_order_release);
+    if (count >= m_sleepers.load(std::memory_order_relaxed)) {
+        m_wake_epoch.notify_all();
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            m_wake_epoch.notify_one();
+        }
+    }
+}
+
+bool ThreadPool::has_queued_tasks() const {
+    if (m_deadline_tasks.size() > 0) {
+        return true;
+    }
+    for (const InjectionQueue& queue : m_tasks) {
+        if (queue.size() > 0) {
+            return true;
+        }
+    }
+    for (const auto& queue : m_node_tasks) {
+        if (queue->size() > 0) {
+            return true;
+        }
+    }
+    for (const auto& state : m_worker_states) {
+        if (!state->local_tasks.empty()) {
+            return true;
         }
-        task();
+    }
+    return false;
+}
+
+void ThreadPool::record_latency(std::string_view task_name, TaskClock::duration queue_wait, TaskClock::duration run_time) {
+    if (WorkerState* self = current_worker_state()) {
+        self->stats.record(task_name, queue_wait, run_time);
+        return;
+    }
+    // Coroutines can finish on another pool's worker.
+    std::scoped_lock lock(m_external_stats_mutex);
+    m_external_stats.record(task_name, queue_wait, run_time);
+}
+
+std::vector<TaskLatency> ThreadPool::latency_snapshot() const {
+    std::vector<TaskLatency> per_worker;
+    for (const auto& state : m_worker_states) {
+        state->stats.snapshot_into(per_worker);
+    }
+    m_external_stats.snapshot_into(per_worker);
+
+    std::vector<TaskLatency> merged;
+    merge_latencies(merged, per_worker);
+    return merged;
+}
+
+unique_task ThreadPool::find_task(WorkerState* self, std::uint64_t& rng_state) {
+    if (m_by_deadline) {
+        return find_task_by_deadline();
+    }
+    unique_task task;
+    // Aging: a lower level that has been passed over often enough goes first, once.
+    for (size_t level = priority_count - 1; level > 0 && !task && m_options.aging_interval != 0; --level) {
+        if (m_passed_over[level].load(std::memory_order_relaxed) >= m_options.aging_interval
+            && (task = take_task_at(level, self, rng_state))) {
+            m_passed_over[level].store(0, std::memory_order_relaxed);
+        }
+    }
+    for (size_t level = 0; level < priority_count && !task; ++level) {
+        if ((task = take_task_at(level, self, rng_state))) {
+            for (size_t lower = level + 1; lower < priority_count; ++lower) {
+                if (has_tasks_at(lower, self)) {
+                    m_passed_over[lower].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+    if (task) {
+        release_slot();
+    }
+    return task;
+}
+
+unique_task ThreadPool::find_task_by_deadline() {
+    unique_task task;
+    TaskClock::time_point deadline;
+    while (m_deadline_tasks.try_pop(task, deadline)) {
+        release_slot();
+        if (deadline == TaskClock::time_point::max()) {
+            return task;
+        }
+        // Checked on the way out rather than on the way in, so that a task
+        // that waited too long is caught however long the queue was.
+        const TaskClock::time_point now = TaskClock::now();
+        if (now <= deadline) {
+            return task;
+        }
+        expire(std::move(task), now - deadline);
+    }
+    return {};
+}
+
+void ThreadPool::expire(unique_task&& task, TaskClock::duration lateness) {
+    using enum log::Level;
+    m_expired.fetch_add(1, std::memory_order_relaxed);
+    if (!m_options.on_expired) {
+        log::print<Debug>("ThreadPool", "Dropped a task {} us past its deadline.",
+                          std::chrono::duration_cast<std::chrono::microseconds>(lateness).count());
+        return;
+    }
+    try {
+        m_options.on_expired(std::move(task));
+    } catch (const std::exception& e) {
+        const char* error_what = e.what();
+        log::print<Error>("ThreadPool", "The '{}' pool's on_expired handler failed: {}", m_options.name, error_what);
+    } catch (...) {
+        log::print<Error>("ThreadPool", "The '{}' pool's on_expired handler failed with an unknown exception.", m_options.name);
+    }
+}
+
+unique_task ThreadPool::take_task_at(size_t level, WorkerState* self, std::uint64_t& rng_state) {
+    unique_task task;
+    if (level != static_cast<size_t>(Priority::Normal)) {
+        m_tasks[level].try_pop(task);
+        return task;
+    }
+    if (self) {
+        if (auto local = self->local_tasks.pop()) {
+            // 1. Our own deque, newest first.
+            return take_task(*local);
+        }
+        if (!m_node_tasks.empty() && m_node_tasks[self->node]->try_pop(task)) {
+            // 2. Tasks meant for our NUMA node.
+            return task;
+        }
+    }
+    // 3. The shared injection queue, then 4. somebody else's work, see steal_task.
+    if (!m_tasks[level].try_pop(task)) {
+        task = steal_task(rng_state, self);
+    }
+    return task;
+}
+
+// A cheap check for aging; other workers' deques are not looked at.
+bool ThreadPool::has_tasks_at(size_t level, const WorkerState* self) const {
+    return m_tasks[level].size() > 0
+        || (self && level == static_cast<size_t>(Priority::Normal)
+            && (!self->local_tasks.empty() || (!m_node_tasks.empty() && m_node_tasks[self->node]->size() > 0)));
+}
+
+// Somebody else's deque, oldest first. With NUMA nodes: the deques of our own
+// node's workers, then the other nodes' queues, and only then remote deques.
+unique_task ThreadPool::steal_task(std::uint64_t& rng_state, const WorkerState* self) {
+    if (m_node_tasks.empty()) {
+        return steal_from_workers(rng_state, self, Locality::Any);
+    }
+    const size_t home = self ? self->node : 0;
+    unique_task task = steal_from_workers(rng_state, self, self ? Locality::SameNode : Locality::Any);
+    for (size_t k = self ? 1 : 0; k < m_node_tasks.size() && !task; ++k) {
+        m_node_tasks[(home + k) % m_node_tasks.size()]->try_pop(task);
+    }
+    if (!task && self) {
+        task = steal_from_workers(rng_state, self, Locality::OtherNodes);
+    }
+    return task;
+}
+
+unique_task ThreadPool::steal_from_workers(std::uint64_t& rng_state, const WorkerState* self, Locality locality) {
+    const size_t count = m_worker_states.size();
+    const size_t first = static_cast<size_t>(next_random(rng_state) % count);
+    for (size_t i = 0; i < count; ++i) {
+        WorkerState& victim = *m_worker_states[(first + i) % count];
+        if (&victim == self || (locality == Locality::SameNode && victim.node != self->node)
+            || (locality == Locality::OtherNodes && victim.node == self->node)) {
+            continue;
+        }
+        if (auto stolen = victim.local_tasks.steal()) {
+            return take_task(*stolen);
+        }
+    }
+    return {};
+}
+
+bool ThreadPool::run_pending_task() {
+    WorkerState* self = current_worker_state();
+    unique_task task = find_task(self, self ? self->rng_state : helper_rng_state);
+    if (!task) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+bool ThreadPool::local_queue_empty() const {
+    if (m_by_deadline) {
+        return m_deadline_tasks.size() == 0;
+    }
+    if (const WorkerState* self = current_worker_state()) {
+        return self->local_tasks.empty();
+    }
+    return m_tasks[static_cast<size_t>(Priority::Normal)].size() == 0;
+}
+
+bool ThreadPool::spin_for_work(const std::stop_token& stoken) {
+    if (!m_spin_when_idle) {
+        return false;
+    }
+    m_spinners.fetch_add(1, std::memory_order_relaxed);
+    bool found = false;
+    for (int round = 0; round < spin_rounds && !found; ++round) {
+        for (int i = 0; i < pauses_per_spin_round; ++i) {
+            cpu_relax();
+        }
+        found = stoken.stop_requested() || has_queued_tasks();
+    }
+    // Decremented before park() publishes the sleeper, so a producer that
+    // skipped its wake because of us is still caught by park()'s own check.
+    m_spinners.fetch_sub(1, std::memory_order_relaxed);
+    return found;
+}
+
+void ThreadPool::park(const std::stop_token& stoken) {
+    uint32_t epoch = m_wake_epoch.load(std::memory_order_acquire);
+    if ((epoch & wake_pending) == 0) {
+        m_sleepers.fetch_add(1, std::memory_order_relaxed);
+        // Pairs with the fence in push_task: either the producer sees us or we see its task.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!stoken.stop_requested() && !drained() && !has_queued_tasks()) {
+            m_wake_epoch.wait(epoch, std::memory_order_acquire);
+        }
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+        epoch = m_wake_epoch.load(std::memory_order_acquire);
+    }
+    // Answer a pending wake, so that producers may request another one. Any
+    // task queued by a producer that saw the bit set is visible after the fence.
+    while ((epoch & wake_pending) != 0 && !m_wake_epoch.compare_exchange_weak(epoch, epoch + 1, std::memory_order_acq_rel)) {
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void ThreadPool::worker_loop(std::stop_token stoken, size_t index) {
+    current_worker = {this, index};
+    WorkerState& self = *m_worker_states[index];
+    if (!self.cpus.empty() && !pin_current_thread(self.cpus)) {
+        log::print<log::Level::Warning>("ThreadPool", "Could not pin a worker of the '{}' pool; it runs wherever the kernel puts it.", m_options.name);
+    }
+
+    bool was_idle = false;
+    while (!stoken.stop_requested()) {
+        if (unique_task task = find_task(&self, self.rng_state)) {
+            // Producers do not wake anyone while a worker spins, so the worker
+            // that ends the spell passes the wake on if more work is waiting.
+            if (std::exchange(was_idle, false) && m_sleepers.load(std::memory_order_relaxed) > 0 && has_queued_tasks()) {
+                wake_one_worker();
+            }
+            // Only this worker writes its counter, so no locked increment is needed.
+            self.progress.store(self.progress.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            task();
+            self.progress.store(self.progress.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (drained()) {
+            break;
+        }
+        was_idle = true;
+        if (!spin_for_work(stoken)) {
+            park(stoken);
+        }
+    }
+
+    // A retired worker hands back whatever is left in its deque, to its own
+    // node's queue, where the tasks' data most likely is; on shutdown the
+    // destructor discards it instead.
+    if (!m_stop_source.stop_requested()) {
+        current_worker = {}; // So that push_task does not put them straight back.
+        const TaskOptions handback{.node = static_cast<int>(m_node_ids[self.node])};
+        while (auto node = self.local_tasks.pop()) {
+            push_task(take_task(*node), handback);
+        }
+    }
+    {
+        const std::scoped_lock lock(m_shutdown_mutex);
+        self.exited.store(true, std::memory_order_release);
+    }
+    m_worker_exited.notify_all();
+    if (m_draining.load(std::memory_order_relaxed)) {
+        // Workers parked while we were busy re-check whether the drain is over.
+        m_wake_epoch.fetch_add(2, std::memory_order_release);
+        m_wake_epoch.notify_all();
     }
 }
 
@@ -1,19 +1,36 @@
 // fire_n_go.hpp
 #pragma once
 
+#include "cpu_topology.hpp"
 #include "logger.hpp" // For logging
+#include "rate_limiter.hpp"
+#include "task_coalescer.hpp"
+#include "task_queue.hpp"
+#include "task_stats.hpp"
+#include "timer_wheel.hpp"
+#include "unique_task.hpp"
+#include "work_stealing_deque.hpp"
 #include <stdexcept>    // For std::runtime_error
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <concepts>
 #include <condition_variable>
+#include <cstring>    // For std::memcpy
+#include <exception>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <ranges>
+#include <span>
 #include <stop_token> // For std::stop_source and std::stop_token
-#include <string>     // For std::string
+#include <string>
 #include <string_view>
 #include <thread> // For std::jthread
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -26,9 +43,207 @@ struct TaskFailure : std::runtime_error {
 };
 
 
+// Compile-time selection of the injection queue backend (see QUEUE in the Makefile).
+#ifdef FNGO_MPMC_QUEUE
+using InjectionQueue = MpmcRingQueue<unique_task>;
+#else
+using InjectionQueue = LockedTaskQueue<unique_task>;
+#endif
+static_assert(TaskQueuePolicy<InjectionQueue, unique_task>);
+
+// Default bound and overflow policy of the global pool (see the Makefile).
+// A bound of 0 means unbounded.
+#ifndef FNGO_MAX_QUEUED_TASKS
+#define FNGO_MAX_QUEUED_TASKS 0
+#endif
+#ifndef FNGO_OVERFLOW_POLICY
+#define FNGO_OVERFLOW_POLICY Block
+#endif
+
+// Worker limit of the global pool when it grows under load (see the Makefile).
+// 0 keeps it at its initial size.
+#ifndef FNGO_MAX_THREADS
+#define FNGO_MAX_THREADS 0
+#endif
+
+/**
+ * @brief What a bounded pool does with a new task while it is full.
+ */
+enum class OverflowPolicy {
+    Block,      // Wait for room. On one of the pool's own workers, run the task inline instead.
+    FailFast,   // Reject the task.
+    DropOldest, // Discard the oldest queued task to make room; never an enqueue() continuation. With only those queued, reject it.
+    CallerRuns  // Run the task on the submitting thread.
+};
+
+/**
+ * @brief What ThreadPool::shutdown does with tasks that are still queued.
+ */
+enum class ShutdownMode {
+    Drain,              // Run every queued task, and any task those tasks queue, then stop.
+    DrainUntilDeadline, // Drain until the timeout, then drop what is left.
+    CancelPending       // Let running tasks finish and drop the queued ones.
+};
+
+/**
+ * @brief Scheduling class of a task.
+ *
+ * Workers take Critical tasks before Normal ones and Normal before Background
+ * ones. To keep a steady stream of urgent work from starving the rest, a level
+ * that had tasks waiting while PoolOptions::aging_interval tasks of a higher
+ * level were taken is served next, once.
+ */
+enum class Priority : uint8_t {
+    Critical,
+    Normal,
+    Background
+};
+inline constexpr size_t priority_count = 3;
+
+/**
+ * @brief How a ThreadPool orders the tasks waiting for a worker.
+ */
+enum class QueueDiscipline {
+    Priority,        // By Priority level, with aging; see Priority.
+    EarliestDeadline // Earliest TaskOptions::deadline first; late tasks are shed, see PoolOptions::on_expired.
+};
+
+/**
+ * @brief Where a ThreadPool's workers may run.
+ *
+ * With Node or Core, workers are spread over the NUMA nodes in proportion to
+ * their CPUs (see PoolOptions::cpus), and the pool keeps a queue per node:
+ * a worker serves its own node's tasks first and steals from workers on its
+ * own node before it looks at other nodes. Ignored where the platform has
+ * no thread affinity API.
+ */
+enum class Affinity {
+    None, // The kernel places and migrates workers freely.
+    Node, // Each worker may run on any CPU of its NUMA node.
+    Core  // Each worker is pinned to one CPU.
+};
+
+/**
+ * @brief A task that a RetryPolicy gave up on, handed to RetryPolicy::on_dead_letter.
+ */
+struct DeadLetter {
+    std::string task_name;
+    unsigned attempts = 0;    // Runs made, the first one included.
+    std::exception_ptr error; // What the last run threw.
+};
+
+/**
+ * @brief When and how often a failed task is run again, meant for designated initializers:
+ * `std::make_shared<const RetryPolicy>(RetryPolicy{.max_attempts = 5})`.
+ *
+ * The wait before each retry grows from initial_backoff by multiplier up to
+ * max_backoff, and part of it is drawn at random so that tasks that failed
+ * together do not retry in lockstep. The wait happens on the pool's timer
+ * thread, not on a worker. A task that runs out of attempts, throws a
+ * non-retryable exception, or whose retry the pool discards at shutdown, is
+ * handed to on_dead_letter. A draining shutdown runs a waiting retry without
+ * its backoff, but schedules no retry after that.
+ */
+struct RetryPolicy {
+    unsigned max_attempts = 3; // Runs in total, the first one included.
+    std::chrono::milliseconds initial_backoff{100};
+    double multiplier = 2.0;
+    std::chrono::milliseconds max_backoff{30'000};
+    // Share of each wait drawn at random: 0 waits exactly the backoff, 1 anywhere up to it.
+    double jitter = 0.5;
+    // Whether a run that threw this should be retried. Unset: TaskFailure only.
+    std::function<bool(const std::exception_ptr&)> retry_if = {};
+    // Called on the thread where the task gave up, e.g. to push it to a
+    // queue for later inspection. Unset: an error is logged.
+    std::function<void(DeadLetter)> on_dead_letter = {};
+
+    // The wait before the run following `attempts` failed ones.
+    TaskClock::duration backoff(unsigned attempts) const;
+    bool should_retry(const std::exception_ptr& error) const;
+    void give_up(DeadLetter letter) const;
+};
+
+/**
+ * @brief Per-task options, meant for designated initializers:
+ * `fire_and_forget("Update User Cache", update, {.priority = Priority::Background});`
+ */
+struct TaskOptions {
+    Priority priority = Priority::Normal;
+    // Latest time the task may start. Only an EarliestDeadline pool looks at
+    // it; there, tasks without one run after every task that has one.
+    TaskClock::time_point deadline = TaskClock::time_point::max();
+    // NUMA node (as numbered in /sys/devices/system/node) whose workers should
+    // run the task, e.g. the one that holds its data; -1: any. Honoured for
+    // Normal tasks by a pool with node-aware Affinity. Other nodes' workers
+    // may still steal the task once they run out of work.
+    int node = -1;
+    // fire_and_forget only: cancels the task, through its TaskHandle, once
+    // this long has passed since it was submitted. Zero: no timeout.
+    TaskClock::duration timeout = TaskClock::duration::zero();
+    // fire_and_forget and try_fire_and_forget only: merges the task into a
+    // queued, not yet started one of the same name on the same pool. Not
+    // combined with a timeout, which makes every task cancellable on its own.
+    Coalesce coalesce = Coalesce::None;
+    // fire_and_forget and try_fire_and_forget only: runs the task again when
+    // it throws, as the policy says. Shared, since one policy usually serves
+    // many tasks. Not combined with a timeout.
+    std::shared_ptr<const RetryPolicy> retry = {};
+};
+
+/**
+ * @brief Configuration of a ThreadPool, meant for designated initializers:
+ * `ThreadPool batch({.name = "batch", .threads = 8});`
+ */
+struct PoolOptions {
+    std::string name = "default"; // Used in log lines and in the FNGO_THREADS_<NAME> variable.
+    // Worker count. 0: the FNGO_THREADS_<NAME> environment variable (name
+    // upper-cased), else FNGO_THREADS, else std::thread::hardware_concurrency().
+    size_t threads = 0;
+    // Elastic sizing: the pool may grow to this many workers, and shrinks back
+    // to `threads` when idle. 0, or not above `threads`: a fixed-size pool.
+    size_t max_threads = 0;
+    // Grow when tasks have waited this long with no worker free.
+    std::chrono::milliseconds grow_after{10};
+    // A worker that has been inside one task this long counts as blocked; the
+    // pool starts another so that `threads` workers stay available.
+    std::chrono::milliseconds blocked_after{100};
+    // A worker started by growth retires after being idle this long.
+    std::chrono::milliseconds keep_alive{5000};
+    size_t max_queued_tasks = 0; // 0: unbounded.
+    OverflowPolicy overflow = OverflowPolicy::Block;
+    // Poll for work briefly before parking an idle worker. Ignored on a single core.
+    bool spin_when_idle = true;
+    // Higher-priority tasks a waiting lower-priority level lets go first (see
+    // Priority). 0: strict priorities, which can starve Background tasks.
+    unsigned aging_interval = 32;
+    QueueDiscipline discipline = QueueDiscipline::Priority;
+    // EarliestDeadline only: receives each task a worker dequeued after its
+    // deadline had passed, e.g. to hand it to a fallback pool. Unset: the task
+    // is dropped. Either way ThreadPool::expired_count() goes up.
+    std::function<void(unique_task)> on_expired = {};
+    Affinity affinity = Affinity::None;
+    // CPUs the workers are placed on; empty: every CPU the process may use.
+    std::vector<unsigned> cpus = {};
+    // Per-name limits on how often fire_and_forget and try_fire_and_forget
+    // tasks may start, so that callers of e.g. a database need no throttle of
+    // their own. Tasks a limit delays wait on the timer thread and, like
+    // fire_after tasks, are not subject to the queue bound once due.
+    std::vector<RateLimit> rate_limits = {};
+};
+
 // Forward declaration for the ThreadPool class
 class ThreadPool;
 
+// How ThreadPool::try_enqueue_named dealt with a task.
+enum class EnqueueResult { Accepted, Rejected, RateLimited };
+
+// What kind of named task is handed to ThreadPool::try_enqueue_named.
+enum class SubmitKind : uint8_t {
+    Mergeable,   // A new task that may be merged into a queued one of the same name (see Coalesce).
+    Exclusive,   // A new task someone waits for (a future, a task_group, a TaskHandle): never merged.
+    Continuation // A run of work already accepted, such as a timer's: never merged, nor bounded.
+};
+
 // Internal-only function to get the singleton instance of the pool.
 // The definition is in fire_n_go.cpp.
 ThreadPool* get_thread_pool_instance();
@@ -37,11 +252,46 @@ ThreadPool* get_thread_pool_instance();
  * @class ThreadPool
  * @brief Manages a pool of worker jthreads to execute tasks concurrently.
  *
+ * Besides the lazily created global pool, any number of independent pools can
+ * be created, e.g. a small one for latency-critical work next to a large one
+ * for batch jobs, so that one kind of work never queues behind the other.
+ *
+ * Scheduling is work-stealing: every worker owns a Chase-Lev deque. Normal
+ * tasks submitted from inside a worker go to that worker's deque without
+ * taking any lock; other tasks go to one shared injection queue per Priority,
+ * whose backend is chosen at compile time through InjectionQueue. An idle
+ * worker takes a Critical task if there is one; otherwise it drains its own
+ * deque, then the Normal queue, then steals from the other workers, starting
+ * at a random victim, and only then takes a Background task. That is a fixed
+ * number of checks, whatever the number of queued tasks.
+ *
+ * A pool with node-aware Affinity adds one Normal queue per NUMA node, and
+ * stealing prefers victims on the thief's own node, so that memory-heavy
+ * work stays near its data.
+ *
+ * With QueueDiscipline::EarliestDeadline, every task goes instead into one
+ * shared heap ordered by deadline, and a worker that pops a task whose
+ * deadline has already passed sheds it rather than spend time on work whose
+ * result comes too late.
+ *
+ * Delayed and periodic tasks wait in a TimerWheel, driven by a timer thread
+ * that the pool starts the first time one is scheduled.
+ *
+ * An elastic pool (PoolOptions::max_threads) reserves worker slots up to its
+ * maximum, and a periodic timer resizes it. It starts a worker when queued
+ * tasks have found every worker busy for grow_after, or when workers stuck
+ * in long calls leave fewer than PoolOptions::threads available. It stops,
+ * through its jthread's stop_token, an extra worker idle for keep_alive.
+ *
+ * A worker that runs out of work spins for a few microseconds before parking
+ * on a futex (std::atomic::wait). Producers count on that: a submit makes no
+ * system call unless some worker is parked and none is spinning.
+ *
  * @note This class is an internal implementation detail.
  */
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t num_threads);
+    explicit ThreadPool(PoolOptions options = {});
     ~ThreadPool();
 
     // Delete copy and move operations to enforce singleton-like behavior.
@@ -50,28 +300,593 @@ public:
     ThreadPool(ThreadPool&&) = delete;
     ThreadPool& operator=(ThreadPool&&) = delete;
 
-    // The implementation of this template member function is now directly in the header.
+    // Queues a continuation of work the pool has already accepted (a resumed
+    // coroutine, a future's continuation). Never subject to the queue bound,
+    // since shedding it would strand the work it continues.
     template<typename F>
-    void enqueue(F&& task) {
-        {
-            std::scoped_lock lock(m_queue_mutex);
-            m_tasks.emplace(std::forward<F>(task));
+    void enqueue(F&& task, const TaskOptions& options = {}) {
+        submit(unique_task(std::forward<F>(task)), options);
+    }
+
+    // Queues a new task, applying the pool's bound and overflow policy. Returns
+    // false if the task was rejected; it has then been destroyed without running.
+    template<typename F>
+    bool try_enqueue(F&& task, const TaskOptions& options = {}) {
+        return try_submit(unique_task(std::forward<F>(task)), options);
+    }
+
+    // Queues a named task the way every named submission is queued: under
+    // the pool's RateLimit for its name, which may delay or reject it, and,
+    // for a Mergeable task, under TaskOptions::coalesce. A task merged into a
+    // queued one, or delayed by its rate limit, counts as accepted. Whatever
+    // is not queued is destroyed without running.
+    EnqueueResult try_enqueue_named(std::string_view task_name, unique_task&& task, const TaskOptions& options,
+                                    SubmitKind kind = SubmitKind::Mergeable);
+
+    // Queues a new task once delay has passed. The wait happens on the timer
+    // thread, and the queue bound does not apply when the task comes due.
+    // Returns false if the pool is shutting down (from a worker: once its
+    // timers have stopped); the task has then been destroyed.
+    bool try_enqueue_after(TaskClock::duration delay, unique_task&& task, const TaskOptions& options = {});
+
+    // Queues a batch of new tasks, moving from the span, with one queue
+    // reservation, one publication and at most one wake per sleeping worker.
+    // Returns how many were accepted; rejected tasks are destroyed unrun.
+    size_t try_enqueue_bulk(std::span<unique_task> tasks, const TaskOptions& options = {}) {
+        return try_submit_bulk(tasks, options);
+    }
+
+    /**
+     * @brief Stops the pool, dealing with queued tasks as `mode` says.
+     *
+     * New tasks from outside the pool are rejected from the start (enqueue()
+     * continuations are still taken), and timers stop firing. Tasks that
+     * try_enqueue_after was holding back, e.g. for a RateLimit, are queued
+     * right away when draining and dropped otherwise. While draining,
+     * every worker slot, including an elastic pool's vacant ones, works
+     * through the backlog in parallel. Tasks already running are never
+     * interrupted, so the call can outlast the timeout by the longest of them.
+     * Must not be called from one of the pool's own workers. Later calls do nothing.
+     *
+     * @return How many tasks were dropped without running: queued ones, held
+     * ones and those still waiting on a fire_after or fire_every timer.
+     */
+    size_t shutdown(ShutdownMode mode = ShutdownMode::Drain, TaskClock::duration timeout = TaskClock::duration::max());
+
+    // Runs one queued task on the calling thread and returns true, or returns
+    // false if there was none. Lets a thread that waits for work it handed to
+    // the pool help with that work instead of blocking.
+    bool run_pending_task();
+
+    // Whether the calling thread's share of queued work is gone: its own deque
+    // on a worker of this pool, the injection queue on any other thread. Lazily
+    // splitting algorithms read it as a sign that other threads want work.
+    bool local_queue_empty() const;
+
+    // Calls trigger on the pool's timer thread after delay and then, if period
+    // is non-zero, every period. The trigger should only hand work to the pool;
+    // carries_task says it queues a caller's task, which shutdown() then counts
+    // as dropped if the timer is still pending. Once shutdown() has stopped the
+    // timers, drops the trigger and returns an empty handle.
+    TimerHandle schedule_timer(TaskClock::duration delay, TaskClock::duration period, unique_task trigger, bool carries_task = false);
+
+    const std::string& name() const noexcept { return m_options.name; }
+    size_t thread_count() const noexcept { return m_live_workers.load(std::memory_order_relaxed); }
+    // NUMA nodes the workers are spread over; 1 unless placement is node-aware.
+    size_t node_count() const noexcept { return m_node_ids.size(); }
+
+    // Tasks shed because their deadline had passed before a worker got to them.
+    uint64_t expired_count() const noexcept { return m_expired.load(std::memory_order_relaxed); }
+
+    // Submissions merged into a queued task of the same name (see Coalesce).
+    uint64_t coalesced_count() const { return m_coalescer.merged_count(); }
+
+    // Queued tasks submitted with a Coalesce mode, by name.
+    TaskCoalescer& coalescer() noexcept { return m_coalescer; }
+
+    // The limiter of the PoolOptions::rate_limits entry for task_name, or nullptr.
+    RateLimiter* rate_limiter(std::string_view task_name) noexcept {
+        if (m_rate_limiters.empty()) {
+            return nullptr;
         }
-        m_condition.notify_one();
+        const auto found = m_rate_limiters.find(task_name);
+        return found == m_rate_limiters.end() ? nullptr : &found->second;
     }
 
+    // Adds one run of the named task to the calling worker's latency histograms.
+    void record_latency(std::string_view task_name, TaskClock::duration queue_wait, TaskClock::duration run_time);
+
+    // Queue wait and run time histograms of every task name, merged across workers.
+    std::vector<TaskLatency> latency_snapshot() const;
+
+    // A task parked in a worker's deque. The deque needs trivially copyable
+    // elements, so tasks travel through it by pointer; nodes are recycled
+    // through a per-thread free list, so this does not allocate per task.
+    struct TaskNode {
+        unique_task task;
+        TaskNode* next_free = nullptr;
+    };
+
 private:
+    // Per-worker scheduling state, padded so neighbouring workers do not share cache lines.
+    struct alignas(cache_line_size) WorkerState {
+        WorkStealingDeque<TaskNode*> local_tasks;
+        std::uint64_t rng_state; // xorshift state used to pick steal victims
+        size_t node = 0;         // Index into m_node_ids.
+        std::vector<unsigned> cpus; // Affinity mask; empty: unpinned.
+        // Bumped by the worker before and after every task: odd while it runs one.
+        std::atomic<uint64_t> progress{0};
+        std::atomic<bool> exited{false};
+        // Elastic sizing bookkeeping, touched only by resize().
+        enum class Slot { Vacant, Running, Retiring } slot = Slot::Vacant;
+        uint64_t seen_progress = 0;
+        TaskClock::time_point seen_at;
+        TaskStatsTable stats;    // Written only by this worker.
+    };
+
+    // A task try_enqueue_after is holding back until its timer fires.
+    struct HeldTask {
+        unique_task task;
+        TaskOptions options;
+    };
+
+    // Which workers steal_from_workers considers, relative to the thief's NUMA node.
+    enum class Locality { Any, SameNode, OtherNodes };
+
     void start(size_t num_threads);
-    void worker_loop(std::stop_token stoken);
+    void place_workers();
+    void start_worker(size_t index);
+    void resize();
+    bool drained() const;
+    bool all_workers_exited() const;
+    void stop_workers();
+    size_t discard_queued_tasks();
+    void worker_loop(std::stop_token stoken, size_t index);
+    void submit(unique_task&& task, const TaskOptions& options);
+    bool try_submit(unique_task&& task, const TaskOptions& options);
+    void push_task(unique_task&& task, const TaskOptions& options);
+    size_t try_submit_bulk(std::span<unique_task> tasks, const TaskOptions& options);
+    void push_bulk(std::span<unique_task> tasks, const TaskOptions& options);
+    size_t reserve_slots(size_t wanted);
+    bool push_when_slot_frees(unique_task&& task, const TaskOptions& options);
+    void release_slot();
+    bool drop_oldest_task();
+    TimerHandle add_timer(TaskClock::duration delay, TaskClock::duration period, unique_task&& trigger, bool carries_task = false);
+    void release_held_task(uint64_t id);
+    unique_task find_task(WorkerState* self, std::uint64_t& rng_state);
+    unique_task find_task_by_deadline();
+    void expire(unique_task&& task, TaskClock::duration lateness);
+    unique_task take_task_at(size_t level, WorkerState* self, std::uint64_t& rng_state);
+    bool has_tasks_at(size_t level, const WorkerState* self) const;
+    unique_task steal_task(std::uint64_t& rng_state, const WorkerState* self);
+    unique_task steal_from_workers(std::uint64_t& rng_state, const WorkerState* self, Locality locality);
+    size_t node_index(int node) const;
+    InjectionQueue& queue_for(const TaskOptions& options);
+    WorkerState* local_deque_for(const TaskOptions& options) const;
+    bool has_queued_tasks() const;
+    bool spin_for_work(const std::stop_token& stoken);
+    void park(const std::stop_token& stoken);
+    void wake_one_worker();
+    void wake_workers(size_t count);
+    WorkerState* current_worker_state() const;
 
-    std::vector<std::jthread> m_workers;
-    std::queue<std::function<void()>> m_tasks;
-    std::mutex m_queue_mutex;
-    std::condition_variable m_condition;
+    std::vector<std::unique_ptr<WorkerState>> m_worker_states;
+    std::array<InjectionQueue, priority_count> m_tasks; // Indexed by Priority; Normal tasks from workers use their deques.
+    std::vector<std::unique_ptr<InjectionQueue>> m_node_tasks; // Normal tasks for one NUMA node; empty on one node.
+    std::vector<unsigned> m_node_ids{0}; // NUMA node ids the workers are spread over.
+    std::array<std::atomic<unsigned>, priority_count> m_passed_over{}; // Aging counters, see Priority.
+    DeadlineTaskQueue<unique_task, TaskClock::time_point> m_deadline_tasks; // Every task, with EarliestDeadline.
+    std::atomic<uint64_t> m_expired{0};
+    TaskCoalescer m_coalescer;
+    // Filled by the constructor and read-only after it, so lookups need no lock.
+    std::unordered_map<std::string, RateLimiter, TaskNameHash, std::equal_to<>> m_rate_limiters;
+    const PoolOptions m_options;
+    const bool m_by_deadline;
+    alignas(cache_line_size) std::atomic<size_t> m_queued{0}; // Only maintained for a bounded pool.
+    std::atomic<size_t> m_blocked_producers{0}; // Producers in push_when_slot_frees.
+    std::atomic<uint32_t> m_slot_epoch{0}; // Futex word blocked producers wait on.
+    const bool m_spin_when_idle;
+    alignas(cache_line_size) std::atomic<uint32_t> m_wake_epoch{0}; // Futex word parked workers wait on.
+    std::atomic<size_t> m_sleepers{0}; // Workers parked, or about to park, on m_wake_epoch.
+    std::atomic<size_t> m_spinners{0}; // Workers polling for work before parking.
     std::stop_source m_stop_source;
+    TaskStatsTable m_external_stats; // Runs that ended on a thread outside this pool.
+    std::mutex m_external_stats_mutex; // Serializes writers of m_external_stats.
+    size_t m_min_workers = 0;
+    std::atomic<size_t> m_live_workers{0}; // Running workers, not counting retiring ones.
+    std::optional<TaskClock::time_point> m_saturated_since; // Owned by resize().
+    std::atomic<bool> m_closed{false};   // shutdown() has begun: outside submissions are rejected.
+    std::atomic<bool> m_draining{false}; // Workers exit once they find no work.
+    std::mutex m_shutdown_mutex;         // Serializes shutdown(); pairs with m_worker_exited.
+    std::condition_variable m_worker_exited;
+    bool m_shut_down = false;
+    const std::shared_ptr<TimerWheel> m_timers = std::make_shared<TimerWheel>(); // Shared with TimerHandles.
+    std::mutex m_timer_mutex;     // Guards starting the timer thread and m_timers_stopped.
+    bool m_timers_stopped = false; // Set by shutdown() before it stops the timer thread; no timer is added after.
+    // Guarded by m_timer_mutex; keyed by submission order, so that shutdown() releases them in that order.
+    std::map<uint64_t, HeldTask> m_held_tasks;
+    uint64_t m_next_held_id = 0;
+    std::jthread m_timer_thread;
+    std::vector<std::jthread> m_workers; // One per slot. Declared last so workers never outlive the state above.
+};
+
+
+/**
+ * @class TaskName
+ * @brief An owning copy of a task name that keeps short names inline.
+ *
+ * Names of up to inline_capacity characters are stored in the object itself, so
+ * capturing one in a task does not allocate the way a std::string would for
+ * names longer than its own small-string buffer.
+ */
+class TaskName {
+public:
+    static constexpr size_t inline_capacity = 28;
+
+    explicit TaskName(std::string_view name) : m_size(static_cast<uint32_t>(name.size())) {
+        char* target = m_inline;
+        if (name.size() > inline_capacity) {
+            m_heap = std::make_unique_for_overwrite<char[]>(name.size());
+            target = m_heap.get();
+        }
+        std::memcpy(target, name.data(), name.size());
+    }
+
+    std::string_view view() const noexcept {
+        return {m_heap ? m_heap.get() : m_inline, m_size};
+    }
+
+private:
+    std::unique_ptr<char[]> m_heap;
+    uint32_t m_size;
+    char m_inline[inline_capacity];
+};
+
+
+/**
+ * @brief Logs an exception that escaped a task, classified by its type.
+ *
+ * Shared by every task runner so that a failure reads the same whether it came
+ * from fire_and_forget or from a detached coroutine.
+ */
+inline void log_task_exception(std::string_view task_name, std::exception_ptr error) {
+    using enum log::Level;
+    try {
+        std::rethrow_exception(std::move(error));
+    }
+    // SONARCLOUD FIX: Catch the most specific exception type first.
+    catch (const TaskFailure& e) {
+        const char* error_what = e.what();
+        log::print<Error>("TaskRunner", "A known task failure occurred in '{}': {}", task_name, error_what);
+    }
+    // Catch other standard exceptions next.
+    /*NO SONAR*/ catch (const std::exception& e) {
+        const char* error_what = e.what();
+        log::print<Error>("TaskRunner", "An unknown standard exception caught in task '{}': {}", task_name, error_what);
+    }
+    // Finally, catch anything else to prevent the worker from crashing.
+    /*NO SONAR*/ catch (...) {
+        log::print<Error>("TaskRunner", "A non-standard, unknown exception caught in task '{}'", task_name);
+    }
+}
+
+
+/**
+ * @brief Wraps a task so that its run is logged and timed like every fire_and_forget task.
+ *
+ * @note This function is an internal implementation detail.
+ */
+template<typename Callable>
+auto make_logged_task(ThreadPool* pool_instance, std::string_view task_name, Callable&& task) {
+    return [pool_instance, name = TaskName(task_name), work = std::forward<Callable>(task),
+            enqueued = TaskClock::now()]() mutable {
+        using enum log::Level;
+        const auto started = TaskClock::now();
+        log::print<Info>("TaskRunner", "Starting task: '{}'", name.view());
+        try {
+            std::invoke(std::move(work));
+            log::print<Info>("TaskRunner", "Finished task: '{}'", name.view());
+        } catch (...) {
+            log_task_exception(name.view(), std::current_exception());
+        }
+        pool_instance->record_latency(name.view(), started - enqueued, TaskClock::now() - started);
+    };
+}
+
+
+/**
+ * @class RetryingTask
+ * @brief A task run under a RetryPolicy, logged and timed like make_logged_task's.
+ *
+ * After a failed run that may be retried, the task moves its state into a new
+ * RetryingTask that the pool queues once the backoff has passed. A retry that
+ * is destroyed without running, because the pool discarded it or could not
+ * schedule it, gives up with the error of the run before it.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename Fn>
+class RetryingTask {
+public:
+    RetryingTask(ThreadPool* pool, std::string_view task_name, Fn fn, const TaskOptions& options)
+        : m_state(std::make_unique<State>(pool, TaskName(task_name), std::move(fn), options, TaskClock::now())) {}
+    RetryingTask(RetryingTask&&) noexcept = default;
+    RetryingTask& operator=(RetryingTask&&) = delete;
+
+    ~RetryingTask() {
+        if (m_state && m_state->last_error) {
+            give_up();
+        }
+    }
+
+    void operator()() {
+        using enum log::Level;
+        State& state = *m_state;
+        const RetryPolicy& policy = *state.options.retry;
+        const std::string_view name = state.name.view();
+        ++state.attempts;
+        const auto started = TaskClock::now();
+        if (state.attempts == 1) {
+            log::print<Info>("TaskRunner", "Starting task: '{}'", name);
+        } else {
+            log::print<Info>("TaskRunner", "Starting task: '{}' (attempt {} of {})", name, state.attempts, policy.max_attempts);
+        }
+        try {
+            std::invoke(state.fn);
+            log::print<Info>("TaskRunner", "Finished task: '{}'", name);
+            state.last_error = nullptr;
+        } catch (...) {
+            state.last_error = std::current_exception();
+            log_task_exception(name, state.last_error);
+        }
+        state.pool->record_latency(name, started - state.enqueued, TaskClock::now() - started);
+
+        if (!state.last_error) {
+            return;
+        }
+        if (state.attempts >= policy.max_attempts || !policy.should_retry(state.last_error)) {
+            give_up();
+            return;
+        }
+        const TaskClock::duration delay = policy.backoff(state.attempts);
+        log::print<Warning>("TaskRunner", "Retrying task '{}' in {} ms (attempt {} of {}).", name,
+                            std::chrono::duration_cast<std::chrono::milliseconds>(delay).count(), state.attempts + 1, policy.max_attempts);
+        state.enqueued = TaskClock::now() + delay;
+        // The state stays where it is, so `state` is still valid while the retry is handed over.
+        state.pool->try_enqueue_after(delay, unique_task(RetryingTask(std::move(m_state))), state.options);
+    }
+
+private:
+    struct State {
+        ThreadPool* pool;
+        TaskName name;
+        Fn fn;
+        TaskOptions options;
+        TaskClock::time_point enqueued;
+        unsigned attempts = 0;
+        std::exception_ptr last_error; // Set between a failed run and its retry.
+    };
+
+    explicit RetryingTask(std::unique_ptr<State> state) noexcept : m_state(std::move(state)) {}
+
+    void give_up() {
+        State& state = *m_state;
+        state.options.retry->give_up(DeadLetter{std::string(state.name.view()), state.attempts, std::exchange(state.last_error, nullptr)});
+    }
+
+    std::unique_ptr<State> m_state;
+};
+
+
+/**
+ * @brief Wraps a task like make_logged_task, under TaskOptions::retry if it is set.
+ *
+ * A retried callable runs more than once, so one that can only be invoked as
+ * an rvalue is never retried.
+ *
+ * @note This function is an internal implementation detail.
+ */
+template<typename Callable>
+unique_task make_retrying_task(ThreadPool& pool, std::string_view task_name, Callable&& task, const TaskOptions& options) {
+    if constexpr (std::invocable<std::decay_t<Callable>&>) {
+        if (options.retry) {
+            return unique_task(RetryingTask<std::decay_t<Callable>>(&pool, task_name, std::forward<Callable>(task), options));
+        }
+    }
+    return unique_task(make_logged_task(&pool, task_name, std::forward<Callable>(task)));
+}
+
+
+/**
+ * @brief Logs why ThreadPool::try_enqueue_named did not accept a task.
+ *
+ * @note This function is an internal implementation detail.
+ */
+inline void log_rejected_task(const ThreadPool& pool, std::string_view task_name, EnqueueResult result) {
+    if (result == EnqueueResult::RateLimited) {
+        log::print<log::Level::Warning>("TaskRunner", "Task '{}' was rejected: over its rate limit on the '{}' pool.", task_name, pool.name());
+    } else if (result == EnqueueResult::Rejected) {
+        log::print<log::Level::Warning>("TaskRunner", "Task '{}' was rejected: the '{}' pool is full or shutting down.", task_name, pool.name());
+    }
+}
+
+
+/**
+ * @class TaskCancelState
+ * @brief The stop source and progress of one cancellable task, shared with its TaskHandle.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class TaskCancelState {
+public:
+    enum class Phase : uint8_t { Queued, Running, Finished };
+
+    std::stop_source source;
+    std::atomic<Phase> phase{Phase::Queued};
+    TimerHandle timeout; // Set before the task is queued; cancelled once it is finished.
+
+    // Called by the worker; false if the task was cancelled while queued.
+    bool begin() noexcept {
+        Phase expected = Phase::Queued;
+        return !source.stop_requested() && phase.compare_exchange_strong(expected, Phase::Running, std::memory_order_acq_rel);
+    }
+
+    void finish() {
+        phase.store(Phase::Finished, std::memory_order_release);
+        timeout.cancel();
+    }
+};
+
+
+/**
+ * @class CancellableTask
+ * @brief The queued form of a cancellable task: skips the work if it was cancelled first.
+ *
+ * Finishes its TaskCancelState even if it never runs, e.g. when it is
+ * rejected or discarded at shutdown, so that its TaskHandle reports it done.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename Fn>
+class CancellableTask {
+public:
+    CancellableTask(std::shared_ptr<TaskCancelState> state, std::string_view task_name, Fn logged)
+        : m_state(std::move(state)), m_name(task_name), m_logged(std::move(logged)) {}
+    CancellableTask(CancellableTask&&) noexcept = default;
+    CancellableTask& operator=(CancellableTask&&) = delete;
+
+    ~CancellableTask() {
+        if (m_state) {
+            m_state->finish();
+        }
+    }
+
+    void operator()() {
+        if (!m_state->begin()) {
+            log::print<log::Level::Debug>("TaskRunner", "Task '{}' was cancelled before it started.", m_name.view());
+        } else {
+            m_logged();
+        }
+        std::exchange(m_state, nullptr)->finish();
+    }
+
+private:
+    std::shared_ptr<TaskCancelState> m_state;
+    TaskName m_name;
+    Fn m_logged;
+};
+
+
+/**
+ * @class TaskHandle
+ * @brief Refers to a task started with a stop_token-taking fire_and_forget.
+ *
+ * Dropping the handle neither cancels the task nor waits for it.
+ */
+class TaskHandle {
+public:
+    TaskHandle() = default;
+    explicit TaskHandle(std::shared_ptr<TaskCancelState> state) noexcept : m_state(std::move(state)) {}
+
+    // A task that has not started yet is skipped when a worker dequeues it,
+    // without running any of its code; a running one sees a stop request on
+    // its token. Returns false if the task had already finished or been cancelled.
+    bool cancel() {
+        return m_state && m_state->phase.load(std::memory_order_acquire) != TaskCancelState::Phase::Finished
+            && m_state->source.request_stop();
+    }
+
+    // Whether the task has finished, was skipped after a cancel, or was rejected.
+    bool done() const noexcept {
+        return !m_state || m_state->phase.load(std::memory_order_acquire) == TaskCancelState::Phase::Finished;
+    }
+
+private:
+    std::shared_ptr<TaskCancelState> m_state;
 };
 
 
+/**
+ * @brief Dispatches a cancellable task to the given thread pool.
+ *
+ * The task receives a std::stop_token, which is signalled by TaskHandle::cancel
+ * or by TaskOptions::timeout; a long-running task should poll it, or register
+ * a std::stop_callback, and return early. The timeout runs on the pool's timer
+ * thread, so stop callbacks should be as cheap as any timer trigger. A
+ * RateLimit the pool has for the task's name may delay or reject the task;
+ * the timeout counts from submission either way.
+ *
+ * @param pool The pool to run the task on.
+ * @param task_name A descriptive name for the task, used for logging.
+ * @param task The callable object, invoked with a std::stop_token.
+ * @param options Scheduling options such as the task's Priority and timeout.
+ * @return A handle to cancel the task with.
+ */
+template<typename Callable>
+TaskHandle fire_and_forget(ThreadPool& pool, std::string_view task_name, Callable&& task, TaskOptions options = {})
+    requires std::invocable<Callable&&, std::stop_token> && (!std::invocable<Callable&&>)
+{
+    auto state = std::make_shared<TaskCancelState>();
+    if (options.timeout > TaskClock::duration::zero()) {
+        state->timeout = pool.schedule_timer(options.timeout, TaskClock::duration::zero(),
+                                             [state] { state->source.request_stop(); });
+    }
+    auto logged = make_logged_task(&pool, task_name,
+        [work = std::forward<Callable>(task), token = state->source.get_token()]() mutable {
+            std::invoke(std::move(work), std::move(token));
+        });
+    // A task that is not queued finishes its state as it is destroyed.
+    log_rejected_task(pool, task_name, pool.try_enqueue_named(task_name, CancellableTask(state, task_name, std::move(logged)),
+                                                              options, SubmitKind::Exclusive));
+    return TaskHandle(std::move(state));
+}
+
+/**
+ * @brief Dispatches a cancellable task to the global thread pool.
+ */
+template<typename Callable>
+TaskHandle fire_and_forget(std::string_view task_name, Callable&& task, TaskOptions options = {})
+    requires std::invocable<Callable&&, std::stop_token> && (!std::invocable<Callable&&>)
+{
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "fire_and_forget called but thread pool is not available.");
+        return {};
+    }
+    return fire_and_forget(*pool_instance, task_name, std::forward<Callable>(task), options);
+}
+
+
+/**
+ * @brief Dispatches a task to the given thread pool for immediate, asynchronous execution.
+ *
+ * If the pool is bounded and rejects the task (see OverflowPolicy), a warning is logged.
+ * With TaskOptions::coalesce set, a task whose name is already queued on the
+ * pool is merged into the queued one instead (see Coalesce). A RateLimit the
+ * pool has for the task's name may delay, reject or merge it as well. With
+ * TaskOptions::retry set, a run that throws is retried after a backoff (see RetryPolicy).
+ *
+ * @tparam Callable The deduced type of the callable object.
+ * @param pool The pool to run the task on.
+ * @param task_name A descriptive name for the task, used for logging.
+ * @param task The callable object (lambda, function pointer, etc.) to be executed.
+ * @param options Scheduling options such as the task's Priority.
+ */
+template<typename Callable>
+void fire_and_forget(ThreadPool& pool, std::string_view task_name, Callable&& task, TaskOptions options = {})
+    // This requires clause is a more precise way to constrain a forwarding reference.
+    requires std::invocable<Callable&&>
+{
+    if (options.timeout > TaskClock::duration::zero()) {
+        // Only a cancellable task can be timed out; this one just cannot see its token.
+        fire_and_forget(pool, task_name, [work = std::forward<Callable>(task)](std::stop_token) mutable {
+            std::invoke(std::move(work));
+        }, options);
+        return;
+    }
+    log_rejected_task(pool, task_name, pool.try_enqueue_named(task_name, make_retrying_task(pool, task_name, std::forward<Callable>(task), options), options));
+}
+
 /**
  * @brief Dispatches a task to the global thread pool for immediate, asynchronous execution.
  *
@@ -80,10 +895,10 @@ private:
  * @tparam Callable The deduced type of the callable object.
  * @param task_name A descriptive name for the task, used for logging.
  * @param task The callable object (lambda, function pointer, etc.) to be executed.
+ * @param options Scheduling options such as the task's Priority.
  */
 template<typename Callable>
-void fire_and_forget(std::string_view task_name, Callable&& task)
-    // This requires clause is a more precise way to constrain a forwarding reference.
+void fire_and_forget(std::string_view task_name, Callable&& task, TaskOptions options = {})
     requires std::invocable<Callable&&>
 {
     ThreadPool* pool_instance = get_thread_pool_instance();
@@ -91,33 +906,331 @@ void fire_and_forget(std::string_view task_name, Callable&& task)
         log::print<log::Level::Error>("TaskRunner", "fire_and_forget called but thread pool is not available.");
         return;
     }
+    fire_and_forget(*pool_instance, task_name, std::forward<Callable>(task), options);
+}
 
-    std::string name_copy(task_name);
 
-    auto wrapped_task = [name = std::move(name_copy), work = std::forward<Callable>(task)]() mutable {
-        using enum log::Level;
-        log::print<Info>("TaskRunner", "Starting task: '{}'", name);
-        try {
-            std::invoke(std::move(work));
-            log::print<Info>("TaskRunner", "Finished task: '{}'", name);
-        } 
-        // SONARCLOUD FIX: Catch the most specific exception type first.
-        catch (const TaskFailure& e) {
-            const char* error_what = e.what();
-            log::print<Error>("TaskRunner", "A known task failure occurred in '{}': {}", name, error_what);
-        }
-        // Catch other standard exceptions next.
-        /*NO SONAR*/ catch (const std::exception& e) {
-            const char* error_what = e.what();
-            log::print<Error>("TaskRunner", "An unknown standard exception caught in task '{}': {}", name, error_what);
-        } 
-        // Finally, catch anything else to prevent the worker from crashing.
-        /*NO SONAR*/ catch (...) {
-            log::print<Error>("TaskRunner", "A non-standard, unknown exception caught in task '{}'", name);
+/**
+ * @brief Like fire_and_forget, but reports whether the pool accepted the task.
+ *
+ * A bounded pool rejects tasks only under OverflowPolicy::FailFast, or while
+ * it is shutting down; any pool rejects them under a RateLimit with
+ * RateLimitPolicy::Reject. Nothing is logged on rejection; that is up to the caller.
+ *
+ * @return true if the task was queued, merged, delayed by a rate limit or,
+ * under CallerRuns, has already run.
+ */
+template<typename Callable>
+[[nodiscard]] bool try_fire_and_forget(ThreadPool& pool, std::string_view task_name, Callable&& task, TaskOptions options = {})
+    requires std::invocable<Callable&&>
+{
+    return pool.try_enqueue_named(task_name, make_retrying_task(pool, task_name, std::forward<Callable>(task), options), options)
+        == EnqueueResult::Accepted;
+}
+
+template<typename Callable>
+[[nodiscard]] bool try_fire_and_forget(std::string_view task_name, Callable&& task, TaskOptions options = {})
+    requires std::invocable<Callable&&>
+{
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "try_fire_and_forget called but thread pool is not available.");
+        return false;
+    }
+    return try_fire_and_forget(*pool_instance, task_name, std::forward<Callable>(task), options);
+}
+
+
+/**
+ * @brief Dispatches a task to the given thread pool once delay has passed.
+ *
+ * The wait happens on the pool's timer thread, not on a worker, so any number
+ * of pending timers cost no worker time. The delay is rounded up to the timer
+ * resolution (1 ms). When it expires, the task is queued like a fire_and_forget
+ * task, except that the pool's queue bound does not apply: it was accepted when
+ * it was scheduled. A RateLimit the pool has for the task's name still applies then.
+ *
+ * @return A handle that can cancel the task before it is due.
+ */
+template<typename Rep, typename Period, typename Callable>
+TimerHandle fire_after(ThreadPool& pool, std::chrono::duration<Rep, Period> delay, std::string_view task_name, Callable&& task,
+                       TaskOptions options = {})
+    requires std::invocable<Callable&&>
+{
+    return pool.schedule_timer(std::chrono::ceil<TaskClock::duration>(delay), TaskClock::duration::zero(),
+        [pool = &pool, name = TaskName(task_name), work = std::forward<Callable>(task), options]() mutable {
+            log_rejected_task(*pool, name.view(), pool->try_enqueue_named(name.view(), make_logged_task(pool, name.view(), std::move(work)),
+                                                                          options, SubmitKind::Continuation));
+        }, true);
+}
+
+template<typename Rep, typename Period, typename Callable>
+TimerHandle fire_after(std::chrono::duration<Rep, Period> delay, std::string_view task_name, Callable&& task, TaskOptions options = {})
+    requires std::invocable<Callable&&>
+{
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "fire_after called but thread pool is not available.");
+        return {};
+    }
+    return fire_after(*pool_instance, delay, task_name, std::forward<Callable>(task), options);
+}
+
+
+/**
+ * @brief The callable and run state of one fire_every timer.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename Fn>
+struct PeriodicTask {
+    TaskName name;
+    Fn fn;
+    std::atomic<bool> running{false};
+
+    // One queued or running run. Clears `running` when destroyed, whether it ran
+    // or the pool discarded it, so that a dropped run cannot stop the timer.
+    class Run {
+    public:
+        explicit Run(std::shared_ptr<PeriodicTask> task) noexcept : m_task(std::move(task)) {}
+        Run(Run&&) noexcept = default;
+        Run& operator=(Run&&) = delete;
+        ~Run() {
+            if (m_task) {
+                m_task->running.store(false, std::memory_order_release);
+            }
         }
+
+        void operator()() { std::invoke(m_task->fn); }
+
+    private:
+        std::shared_ptr<PeriodicTask> m_task;
     };
+};
+
+/**
+ * @brief Dispatches a task to the given thread pool every period, starting one period from now.
+ *
+ * Runs never overlap: if a run has not finished by the time the next one is
+ * due, that one is skipped. Ticks missed by a late timer thread are skipped
+ * too rather than run in a burst. Each run is logged and timed like a
+ * fire_and_forget task, and is subject to the pool's RateLimit for its name;
+ * a run the limit delays counts as running, so ticks meanwhile are skipped.
+ *
+ * @return A handle that stops the timer; dropping it lets the timer run for the pool's lifetime.
+ */
+template<typename Rep, typename Period, typename Callable>
+    requires std::invocable<std::decay_t<Callable>&>
+TimerHandle fire_every(ThreadPool& pool, std::chrono::duration<Rep, Period> period, std::string_view task_name, Callable&& task,
+                       TaskOptions options = {}) {
+    using Task = PeriodicTask<std::decay_t<Callable>>;
+    auto state = std::make_shared<Task>(TaskName(task_name), std::forward<Callable>(task));
+    const auto interval = std::max(std::chrono::ceil<TaskClock::duration>(period), TaskClock::duration(TimerWheel::resolution));
+    return pool.schedule_timer(interval, interval, [pool = &pool, state, options] {
+        if (state->running.exchange(true, std::memory_order_acquire)) {
+            log::print<log::Level::Debug>("TaskRunner", "Skipping a run of '{}': the previous one is still running.", state->name.view());
+            return;
+        }
+        log_rejected_task(*pool, state->name.view(), pool->try_enqueue_named(state->name.view(),
+            make_logged_task(pool, state->name.view(), typename Task::Run(state)), options, SubmitKind::Continuation));
+    }, true);
+}
+
+template<typename Rep, typename Period, typename Callable>
+    requires std::invocable<std::decay_t<Callable>&>
+TimerHandle fire_every(std::chrono::duration<Rep, Period> period, std::string_view task_name, Callable&& task, TaskOptions options = {}) {
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "fire_every called but thread pool is not available.");
+        return {};
+    }
+    return fire_every(*pool_instance, period, task_name, std::forward<Callable>(task), options);
+}
+
+
+/**
+ * @brief State shared by the parts of one fire_and_forget_bulk call.
+ *
+ * The batch is logged as a single task: the first part to start logs
+ * "Starting", and the destructor, which runs once the last part has run or
+ * been discarded, logs "Finished". Each part still reports its own exception
+ * and its own latency sample.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename Fn>
+class BulkTaskState {
+public:
+    BulkTaskState(ThreadPool* pool, std::string_view name, size_t count, Fn fn)
+        : m_pool(pool), m_name(name), m_count(count), m_fn(std::move(fn)) {}
+
+    BulkTaskState(const BulkTaskState&) = delete;
+    BulkTaskState& operator=(const BulkTaskState&) = delete;
+
+    ~BulkTaskState() {
+        if (m_started.load(std::memory_order_relaxed)) {
+            log::print<log::Level::Info>("TaskRunner", "Finished task: '{}'", m_name.view());
+        }
+    }
+
+    template<typename Part>
+    void run(Part&& part) {
+        const auto started = TaskClock::now();
+        if (!m_started.exchange(true, std::memory_order_relaxed)) {
+            log::print<log::Level::Info>("TaskRunner", "Starting task: '{}' ({} parts)", m_name.view(), m_count);
+        }
+        try {
+            std::invoke(std::forward<Part>(part));
+        } catch (...) {
+            log_task_exception(m_name.view(), std::current_exception());
+        }
+        m_pool->record_latency(m_name.view(), started - m_enqueued, TaskClock::now() - started);
+    }
+
+    const Fn& fn() const noexcept { return m_fn; }
+
+    // Only before the parts are published.
+    void set_count(size_t count) noexcept { m_count = count; }
+
+private:
+    ThreadPool* m_pool;
+    TaskName m_name;
+    size_t m_count;
+    Fn m_fn;
+    TaskClock::time_point m_enqueued = TaskClock::now();
+    std::atomic<bool> m_started{false};
+};
+
+// Queues prepared parts on the pool and logs how many were rejected.
+inline size_t enqueue_bulk_parts(ThreadPool& pool, std::string_view task_name, std::vector<unique_task>& parts, TaskOptions options) {
+    if (!pool.rate_limiter(task_name)) {
+        const size_t accepted = pool.try_enqueue_bulk(parts, options);
+        if (accepted < parts.size()) {
+            log::print<log::Level::Warning>("TaskRunner", "{} of {} parts of task '{}' were rejected: the '{}' pool is full or shutting down.",
+                                            parts.size() - accepted, parts.size(), task_name, pool.name());
+        }
+        return accepted;
+    }
+    // Under a RateLimit every part takes its own token, as if submitted one by one.
+    size_t accepted = 0;
+    for (unique_task& part : parts) {
+        accepted += pool.try_enqueue_named(task_name, std::move(part), options, SubmitKind::Exclusive) == EnqueueResult::Accepted ? 1 : 0;
+    }
+    if (accepted < parts.size()) {
+        log::print<log::Level::Warning>("TaskRunner", "{} of {} parts of task '{}' were rejected: the '{}' pool is full, shutting down or over the task's rate limit.",
+                                        parts.size() - accepted, parts.size(), task_name, pool.name());
+    }
+    return accepted;
+}
+
+
+/**
+ * @brief Fans a batch of callables out to the given thread pool in one submission.
+ *
+ * Much cheaper per task than calling fire_and_forget in a loop: the batch is
+ * logged once, its name is stored once, and the tasks are published with a
+ * single queue reservation and a single wake-up round.
+ *
+ * @param pool The pool to run the tasks on.
+ * @param task_name A name for the whole batch, used for logging and latency stats.
+ * @param tasks A range of callables; they are moved from when the range is an rvalue.
+ * @return The number of tasks accepted (see OverflowPolicy).
+ */
+template<std::ranges::input_range Range>
+    requires std::invocable<std::ranges::range_value_t<Range>&>
+size_t fire_and_forget_bulk(ThreadPool& pool, std::string_view task_name, Range&& tasks, TaskOptions options = {}) {
+    using Callable = std::ranges::range_value_t<Range>;
+    struct NoSharedFn {};
+    auto state = std::make_shared<BulkTaskState<NoSharedFn>>(&pool, task_name, 0, NoSharedFn{});
+    std::vector<unique_task> parts;
+    if constexpr (std::ranges::sized_range<Range>) {
+        parts.reserve(std::ranges::size(tasks));
+    }
+    for (auto&& task : tasks) {
+        if constexpr (std::is_lvalue_reference_v<Range>) {
+            parts.emplace_back([state, work = Callable(task)]() mutable { state->run(work); });
+        } else {
+            parts.emplace_back([state, work = Callable(std::move(task))]() mutable { state->run(work); });
+        }
+    }
+    if (parts.empty()) {
+        return 0;
+    }
+    state->set_count(parts.size());
+    return enqueue_bulk_parts(pool, task_name, parts, options);
+}
+
+/**
+ * @brief Runs fn(i) on the given thread pool for every i in [first, last).
+ *
+ * The calls run concurrently on a shared fn, which is why it is invoked as const.
+ *
+ * @return The number of calls accepted (see OverflowPolicy).
+ */
+template<typename Fn>
+    requires std::invocable<const Fn&, size_t>
+size_t fire_and_forget_bulk(ThreadPool& pool, std::string_view task_name, size_t first, size_t last, Fn&& fn, TaskOptions options = {}) {
+    if (first >= last) {
+        return 0;
+    }
+    auto state = std::make_shared<BulkTaskState<std::decay_t<Fn>>>(&pool, task_name, last - first, std::forward<Fn>(fn));
+    std::vector<unique_task> parts;
+    parts.reserve(last - first);
+    for (size_t index = first; index < last; ++index) {
+        parts.emplace_back([state, index] {
+            state->run([&state, index] { std::invoke(state->fn(), index); });
+        });
+    }
+    return enqueue_bulk_parts(pool, task_name, parts, options);
+}
+
+// fire_and_forget_bulk on the global thread pool.
+template<std::ranges::input_range Range>
+    requires std::invocable<std::ranges::range_value_t<Range>&>
+size_t fire_and_forget_bulk(std::string_view task_name, Range&& tasks, TaskOptions options = {}) {
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "fire_and_forget_bulk called but thread pool is not available.");
+        return 0;
+    }
+    return fire_and_forget_bulk(*pool_instance, task_name, std::forward<Range>(tasks), options);
+}
+
+template<typename Fn>
+    requires std::invocable<const Fn&, size_t>
+size_t fire_and_forget_bulk(std::string_view task_name, size_t first, size_t last, Fn&& fn, TaskOptions options = {}) {
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "fire_and_forget_bulk called but thread pool is not available.");
+        return 0;
+    }
+    return fire_and_forget_bulk(*pool_instance, task_name, first, last, std::forward<Fn>(fn), options);
+}
+
 
-    pool_instance->enqueue(std::move(wrapped_task));
+/**
+ * @brief Per-name queue wait and run time histograms of the global thread pool.
+ *
+ * Every task started through fire_and_forget, submit or spawn is recorded.
+ * Snapshots from several pools or points in time combine with merge_latencies.
+ */
+inline std::vector<TaskLatency> task_latency_snapshot() {
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    return pool_instance ? pool_instance->latency_snapshot() : std::vector<TaskLatency>{};
+}
+
+/**
+ * @brief Shuts down the global thread pool ahead of program exit; see ThreadPool::shutdown.
+ *
+ * Useful at deploy time, so that queued cache writes run instead of being
+ * discarded when the pool is destroyed. Tasks submitted afterwards are rejected.
+ *
+ * @return How many queued tasks were dropped without running.
+ */
+inline size_t shutdown_thread_pool(ShutdownMode mode = ShutdownMode::Drain,
+                                   TaskClock::duration timeout = TaskClock::duration::max()) {
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    return pool_instance ? pool_instance->shutdown(mode, timeout) : 0;
 }
 
 } // namespace util
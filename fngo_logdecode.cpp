@@ -0,0 +1,227 @@
+// fngo_logdecode.cpp
+// Turns a binary log written with FNGO_BINARY_LOGS back into the text the
+// synchronous logger would have printed.
+//
+// Usage: fngo_logdecode [-t] [file]   (file defaults to fngo.binlog, "-" reads stdin)
+//   -t  prefix every line with the record's UTC timestamp
+
+#include "binary_log.hpp"
+#include "logger.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace {
+
+using namespace util::log;
+using binary::ArgType;
+
+using Value = std::variant<int64_t, uint64_t, double, bool, char, std::string>;
+
+// Sequential reader over the whole file; throws on truncated input.
+class Reader {
+public:
+    explicit Reader(std::string data) : m_data(std::move(data)) {}
+
+    bool at_end() const noexcept { return m_offset == m_data.size(); }
+
+    template<typename T>
+    T read() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view read_string() { return take(read<uint32_t>()); }
+
+    std::string_view take(size_t size) {
+        if (m_data.size() - m_offset < size) {
+            throw std::runtime_error("truncated log file");
+        }
+        std::string_view bytes(m_data.data() + m_offset, size);
+        m_offset += size;
+        return bytes;
+    }
+
+private:
+    std::string m_data;
+    size_t m_offset = 0;
+};
+
+struct Descriptor {
+    Level level;
+    std::string area;
+    std::string format;
+    std::vector<ArgType> args;
+};
+
+Value read_value(Reader& payload, ArgType type) {
+    using enum ArgType;
+    switch (type) {
+        case Int64:  return payload.read<int64_t>();
+        case UInt64: return payload.read<uint64_t>();
+        case Double: return payload.read<double>();
+        case Bool:   return payload.read<uint8_t>() != 0;
+        case Char:   return static_cast<char>(payload.read<uint8_t>());
+        case String: return std::string(payload.read_string());
+    }
+    throw std::runtime_error("unknown argument type");
+}
+
+// Applies one replacement field's spec, e.g. ":>8" or "", to a decoded value.
+std::string format_value(const Value& value, std::string_view spec) {
+    const std::string field = std::format("{{{}}}", spec);
+    return std::visit([&field](const auto& v) { return std::vformat(field, std::make_format_args(v)); }, value);
+}
+
+// A small std::format interpreter: the format string is only known at run time here.
+std::string render(std::string_view format, const std::vector<Value>& values) {
+    std::string out;
+    size_t next_index = 0;
+    for (size_t i = 0; i < format.size(); ++i) {
+        const char c = format[i];
+        if ((c == '{' || c == '}') && i + 1 < format.size() && format[i + 1] == c) {
+            out.push_back(c);
+            ++i;
+            continue;
+        }
+        if (c != '{') {
+            out.push_back(c);
+            continue;
+        }
+        const size_t close = format.find('}', i);
+        if (close == std::string_view::npos) {
+            out.append(format.substr(i));
+            break;
+        }
+        std::string_view field = format.substr(i + 1, close - i - 1);
+        const size_t colon = field.find(':');
+        std::string_view index_text = field.substr(0, colon);
+        std::string_view spec = colon == std::string_view::npos ? std::string_view{} : field.substr(colon);
+
+        size_t index = next_index++;
+        if (!index_text.empty()) {
+            index = std::stoul(std::string(index_text));
+        }
+        if (index < values.size()) {
+            out.append(format_value(values[index], spec));
+        } else {
+            out.append(format.substr(i, close - i + 1));
+        }
+        i = close;
+    }
+    return out;
+}
+
+// Fallback for a record whose format string does not fit its values: the
+// string as recorded, followed by every value in its default format.
+std::string render_raw(std::string_view format, const std::vector<Value>& values) {
+    std::string out(format);
+    for (size_t i = 0; i < values.size(); ++i) {
+        out.append(i == 0 ? " | " : ", ");
+        out.append(format_value(values[i], {}));
+    }
+    return out;
+}
+
+std::string read_input(std::string_view path) {
+    if (path == "-") {
+        return {std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+    }
+    std::ifstream file{std::string(path), std::ios::binary};
+    if (!file) {
+        throw std::runtime_error(std::format("cannot open '{}'", path));
+    }
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+void decode(Reader& input, bool timestamps, std::ostream& out) {
+    if (input.take(sizeof(binary::file_magic)) != std::string_view(binary::file_magic, sizeof(binary::file_magic))) {
+        throw std::runtime_error("not a fire_n_go binary log");
+    }
+
+    std::unordered_map<uint32_t, Descriptor> descriptors;
+    std::vector<Value> values;
+    while (!input.at_end()) {
+        const auto kind = static_cast<binary::EntryKind>(input.read<uint8_t>());
+        if (kind == binary::EntryKind::Descriptor) {
+            const auto id = input.read<uint32_t>();
+            Descriptor& descriptor = descriptors[id];
+            descriptor.level = static_cast<Level>(input.read<uint8_t>());
+            descriptor.area = input.read_string();
+            descriptor.format = input.read_string();
+            descriptor.args.resize(input.read<uint8_t>());
+            for (ArgType& type : descriptor.args) {
+                type = static_cast<ArgType>(input.read<uint8_t>());
+            }
+            continue;
+        }
+        if (kind != binary::EntryKind::Record) {
+            throw std::runtime_error("corrupt entry");
+        }
+
+        const auto id = input.read<uint32_t>();
+        const auto timestamp = input.read<uint64_t>();
+        const auto thread = input.read<uint64_t>();
+        Reader payload{std::string(input.read_string())};
+        const auto found = descriptors.find(id);
+        if (found == descriptors.end()) {
+            throw std::runtime_error(std::format("record refers to unknown descriptor {}", id));
+        }
+        const Descriptor& descriptor = found->second;
+
+        values.clear();
+        for (ArgType type : descriptor.args) {
+            values.push_back(read_value(payload, type));
+        }
+        // One bad record must not end the decoding of the rest of the log.
+        std::string message;
+        try {
+            message = render(descriptor.format, values);
+        } catch (const std::format_error&) {
+            message = render_raw(descriptor.format, values);
+        } catch (const std::logic_error&) { // A malformed argument index.
+            message = render_raw(descriptor.format, values);
+        }
+        if (timestamps) {
+            const std::chrono::sys_time<std::chrono::nanoseconds> time{std::chrono::nanoseconds(timestamp)};
+            out << std::format("{:%F %T} ", time);
+        }
+        out << std::format("[{:<7}] [{:^12}] [Thread:{}] ", level_to_string(descriptor.level), descriptor.area, thread)
+            << message << '\n';
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    bool timestamps = false;
+    std::string_view path = "fngo.binlog";
+    for (int i = 1; i < argc; ++i) {
+        if (std::string_view arg = argv[i]; arg == "-t") {
+            timestamps = true;
+        } else {
+            path = arg;
+        }
+    }
+
+    try {
+        Reader input(read_input(path));
+        decode(input, timestamps, std::cout);
+    } catch (const std::exception& e) {
+        std::cerr << "fngo_logdecode: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
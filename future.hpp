@@ -0,0 +1,357 @@
+// future.hpp
+#pragma once
+
+#include "fire_n_go.hpp"
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>      // For std::future_error
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace util {
+
+template<typename R> class future;
+template<typename R> class promise;
+
+/**
+ * @class FutureState
+ * @brief The shared state behind a promise/future pair.
+ *
+ * Everything is coordinated through one 32-bit atomic word: a "ready" bit, a
+ * "continuation attached" bit, a "someone is blocked in wait()" bit and a
+ * reference count in the remaining bits. Producer and consumer each set their
+ * bit with a single fetch_or, so exactly one of them observes the other and runs
+ * the continuation; no mutex or condition variable is involved, and a blocked
+ * wait() is woken only when the waiter bit says somebody is actually sleeping.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename R>
+class FutureState {
+public:
+    using value_type = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+    explicit FutureState(ThreadPool* pool) noexcept : m_pool(pool) {}
+
+    void add_ref() noexcept { m_state.fetch_add(ref_one, std::memory_order_relaxed); }
+
+    void release() noexcept {
+        if (m_state.fetch_sub(ref_one, std::memory_order_acq_rel) < 2 * ref_one) {
+            delete this;
+        }
+    }
+
+    bool is_ready() const noexcept { return (m_state.load(std::memory_order_acquire) & ready_bit) != 0; }
+
+    template<typename... Args>
+    void set_value(Args&&... args) {
+        throw_if_satisfied();
+        m_result.template emplace<value_index>(std::forward<Args>(args)...);
+        complete();
+    }
+
+    void set_exception(std::exception_ptr error) {
+        throw_if_satisfied();
+        m_result.template emplace<error_index>(std::move(error));
+        complete();
+    }
+
+    void wait() const noexcept {
+        std::uint32_t current = m_state.load(std::memory_order_acquire);
+        while ((current & ready_bit) == 0) {
+            if ((current & waiter_bit) == 0) {
+                current = m_state.fetch_or(waiter_bit, std::memory_order_acq_rel) | waiter_bit;
+                continue;
+            }
+            m_state.wait(current, std::memory_order_acquire);
+            current = m_state.load(std::memory_order_acquire);
+        }
+    }
+
+    // Waits for the result, then moves the value out or rethrows the stored exception.
+    value_type take() {
+        wait();
+        if (m_result.index() == error_index) {
+            std::rethrow_exception(std::get<error_index>(m_result));
+        }
+        return std::move(std::get<value_index>(m_result));
+    }
+
+    // Ready-only access used by continuations.
+    std::exception_ptr error() const noexcept {
+        return m_result.index() == error_index ? std::get<error_index>(m_result) : nullptr;
+    }
+
+    // Runs the continuation on the pool once the result is available.
+    void on_ready(unique_task&& continuation) {
+        m_continuation = std::move(continuation);
+        if (m_state.fetch_or(continuation_bit, std::memory_order_acq_rel) & ready_bit) {
+            schedule_continuation();
+        }
+    }
+
+    ThreadPool* pool() const noexcept { return m_pool; }
+
+private:
+    static constexpr std::uint32_t ready_bit = 1;
+    static constexpr std::uint32_t continuation_bit = 2;
+    static constexpr std::uint32_t waiter_bit = 4;
+    static constexpr std::uint32_t ref_one = 8;
+    static constexpr std::size_t value_index = 1;
+    static constexpr std::size_t error_index = 2;
+
+    ~FutureState() = default;
+
+    void throw_if_satisfied() const {
+        if (m_result.index() != 0) {
+            throw std::future_error(std::future_errc::promise_already_satisfied);
+        }
+    }
+
+    void complete() {
+        const std::uint32_t previous = m_state.fetch_or(ready_bit, std::memory_order_acq_rel);
+        if (previous & continuation_bit) {
+            schedule_continuation();
+        }
+        if (previous & waiter_bit) {
+            m_state.notify_all();
+        }
+    }
+
+    void schedule_continuation() {
+        if (m_pool) {
+            m_pool->enqueue(std::move(m_continuation));
+        } else {
+            m_continuation(); // Only reachable when no pool was available at all.
+        }
+    }
+
+    mutable std::atomic<std::uint32_t> m_state{ref_one};
+    std::variant<std::monostate, value_type, std::exception_ptr> m_result;
+    unique_task m_continuation;
+    ThreadPool* m_pool;
+};
+
+
+// Drops one reference to a FutureState.
+struct FutureStateReleaser {
+    template<typename R>
+    void operator()(FutureState<R>* state) const noexcept { state->release(); }
+};
+
+
+/**
+ * @class future
+ * @brief The consumer side of a result produced on the thread pool.
+ *
+ * A move-only, single-use handle. get() blocks the calling thread, so inside a
+ * pool task prefer then(), which runs the continuation on the pool instead.
+ */
+template<typename R>
+class future {
+public:
+    future() noexcept = default;
+
+    bool valid() const noexcept { return m_state != nullptr; }
+    bool is_ready() const noexcept { return m_state && m_state->is_ready(); }
+    void wait() const noexcept { m_state->wait(); }
+
+    // Blocks until the result is available, then returns it or rethrows the task's exception.
+    R get() {
+        auto state = std::move(m_state);
+        if constexpr (std::is_void_v<R>) {
+            state->take();
+        } else {
+            return state->take();
+        }
+    }
+
+    /**
+     * @brief Attaches a continuation that runs on the pool when this future is ready.
+     *
+     * The continuation receives the value (nothing for future<void>). If this future
+     * holds an exception, the continuation is skipped and the exception is passed on
+     * to the returned future. Consumes this future.
+     */
+    template<typename F>
+    auto then(F&& continuation) {
+        using U = typename continuation_traits<F>::result_type;
+        auto parent = std::move(m_state);
+        promise<U> next(parent->pool());
+        future<U> result = next.get_future();
+
+        FutureState<R>* ready_state = parent.get();
+        ready_state->on_ready([parent = std::move(parent), next = std::move(next), fn = std::forward<F>(continuation)]() mutable {
+            if (std::exception_ptr error = parent->error()) {
+                next.set_exception(std::move(error));
+                return;
+            }
+            try {
+                if constexpr (std::is_void_v<R>) {
+                    next.set_from(fn);
+                } else {
+                    next.set_from([&fn, &parent]() -> U { return std::invoke(fn, parent->take()); });
+                }
+            } catch (...) {
+                next.set_exception(std::current_exception());
+            }
+        });
+        return result;
+    }
+
+    /**
+     * @brief Lets a coroutine await the result without blocking a thread.
+     *
+     * The coroutine is resumed on the pool when the result is ready; the queued
+     * continuation is the coroutine handle itself.
+     */
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            future pending;
+
+            bool await_ready() const noexcept { return pending.is_ready(); }
+            void await_suspend(std::coroutine_handle<> continuation) { pending.m_state->on_ready(continuation); }
+            R await_resume() { return pending.get(); }
+        };
+        return Awaiter{std::move(*this)};
+    }
+
+private:
+    template<typename R2> friend class promise;
+
+    template<typename F>
+    struct continuation_traits {
+        using result_type = std::invoke_result_t<F&, R&&>;
+    };
+    template<typename F>
+        requires std::is_void_v<R>
+    struct continuation_traits<F> {
+        using result_type = std::invoke_result_t<F&>;
+    };
+
+    explicit future(FutureState<R>* state) noexcept : m_state(state) {}
+
+    std::unique_ptr<FutureState<R>, FutureStateReleaser> m_state;
+};
+
+
+/**
+ * @class promise
+ * @brief The producer side of a future.
+ *
+ * The shared state is the pair's only allocation. Destroying a promise that was
+ * never satisfied stores std::future_errc::broken_promise in its future.
+ */
+template<typename R>
+class promise {
+public:
+    promise() : promise(get_thread_pool_instance()) {}
+    explicit promise(ThreadPool* pool) : m_state(new FutureState<R>(pool)) {}
+
+    promise(promise&&) noexcept = default;
+    promise& operator=(promise&&) = delete;
+    promise(const promise&) = delete;
+    promise& operator=(const promise&) = delete;
+
+    ~promise() {
+        if (m_state && !m_state->is_ready()) {
+            m_state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+    }
+
+    future<R> get_future() {
+        if (m_future_retrieved) {
+            throw std::future_error(std::future_errc::future_already_retrieved);
+        }
+        m_future_retrieved = true;
+        m_state->add_ref();
+        return future<R>(m_state.get());
+    }
+
+    template<typename... Args>
+    void set_value(Args&&... args) { m_state->set_value(std::forward<Args>(args)...); }
+
+    void set_exception(std::exception_ptr error) { m_state->set_exception(std::move(error)); }
+
+    // Stores the result of invoking fn; exceptions propagate to the caller.
+    template<typename F>
+    void set_from(F&& fn) {
+        if constexpr (std::is_void_v<R>) {
+            std::invoke(std::forward<F>(fn));
+            set_value();
+        } else {
+            set_value(std::invoke(std::forward<F>(fn)));
+        }
+    }
+
+private:
+    std::unique_ptr<FutureState<R>, FutureStateReleaser> m_state;
+    bool m_future_retrieved = false;
+};
+
+
+/**
+ * @brief Runs a task on the given thread pool and returns a future for its result.
+ *
+ * Like fire_and_forget, but the return value or the exception thrown by the task
+ * is delivered through the returned future instead of being logged and dropped.
+ * The task and its result share a single allocation. A RateLimit the pool has
+ * for the task's name may delay it. If a bounded pool or a rate limit rejects
+ * the task, or the pool drops it, the future holds std::future_errc::broken_promise.
+ *
+ * @param pool The pool to run the task on; continuations attached with then() run there too.
+ * @param task_name A descriptive name for the task, used for logging.
+ * @param task The callable object to be executed.
+ * @param options Scheduling options such as the task's Priority.
+ * @return A future that becomes ready when the task finishes.
+ */
+template<typename Callable>
+auto submit(ThreadPool& pool, std::string_view task_name, Callable&& task, TaskOptions options = {}) -> future<std::invoke_result_t<Callable&&>>
+    requires std::invocable<Callable&&>
+{
+    using R = std::invoke_result_t<Callable&&>;
+    using enum log::Level;
+
+    promise<R> result(&pool);
+    future<R> result_future = result.get_future();
+    const EnqueueResult queued = pool.try_enqueue_named(task_name, [pool_instance = &pool, name = TaskName(task_name), work = std::forward<Callable>(task),
+                                                                    result = std::move(result), enqueued = TaskClock::now()]() mutable {
+        const auto started = TaskClock::now();
+        log::print<Info>("TaskRunner", "Starting task: '{}'", name.view());
+        try {
+            result.set_from(std::move(work));
+            log::print<Info>("TaskRunner", "Finished task: '{}'", name.view());
+        } catch (...) {
+            log::print<Debug>("TaskRunner", "Task '{}' failed; the exception was stored in its future.", name.view());
+            result.set_exception(std::current_exception());
+        }
+        pool_instance->record_latency(name.view(), started - enqueued, TaskClock::now() - started);
+    }, options, SubmitKind::Exclusive);
+    // A rejected task destroyed its promise, so the future reports broken_promise.
+    log_rejected_task(pool, task_name, queued);
+    return result_future;
+}
+
+/**
+ * @brief Runs a task on the global thread pool and returns a future for its result.
+ */
+template<typename Callable>
+auto submit(std::string_view task_name, Callable&& task, TaskOptions options = {}) -> future<std::invoke_result_t<Callable&&>>
+    requires std::invocable<Callable&&>
+{
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "submit called but thread pool is not available.");
+        promise<std::invoke_result_t<Callable&&>> result(nullptr);
+        result.set_exception(std::make_exception_ptr(TaskFailure("thread pool is not available")));
+        return result.get_future();
+    }
+    return submit(*pool_instance, task_name, std::forward<Callable>(task), options);
+}
+
+} // namespace util
@@ -0,0 +1,413 @@
+// logger.cpp
+#include "logger.hpp"
+
+#ifdef FNGO_ASYNC_LOGS
+
+#include "cache_line.hpp"
+#include <atomic>
+#include <cerrno>
+#include <climits>      // For IOV_MAX
+#include <cstdint>
+#include <cstdlib>      // For std::atexit
+#include <cstring>      // For std::memcpy
+#include <functional>   // For std::hash
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/uio.h>    // For writev
+#include <unistd.h>
+
+#ifdef FNGO_BINARY_LOGS
+#include <algorithm>    // For std::ranges::equal
+#include <deque>
+#include <fcntl.h>      // For open
+#endif
+
+#ifdef FNGO_BINARY_LOGS
+namespace util::log::binary {
+
+namespace { // Anonymous namespace for internal linkage
+
+    // Every call-site descriptor created so far, in id order.
+    class DescriptorRegistry {
+    public:
+        static DescriptorRegistry& instance() {
+            // Leaked for the same reason as the async backend: logging may outlive statics.
+            /*NOSONAR*/ static auto* registry = new DescriptorRegistry();
+            return *registry;
+        }
+
+        const Descriptor& find_or_add(uint8_t level, std::string_view area, const char* format_site,
+                                      std::string_view format, std::span<const ArgType> args) {
+            std::scoped_lock lock(m_mutex);
+            for (const Descriptor& existing : m_descriptors) {
+                if (existing.format_site == format_site && existing.level == level && existing.area == area
+                    && std::ranges::equal(existing.args, args)) {
+                    return existing;
+                }
+            }
+            return m_descriptors.emplace_back(Descriptor{
+                static_cast<uint32_t>(m_descriptors.size()), level, format_site,
+                std::string(area), std::string(format), std::vector<ArgType>(args.begin(), args.end())});
+        }
+
+        // Encodes the descriptors added since the previous call.
+        void encode_new(std::string& out) {
+            std::scoped_lock lock(m_mutex);
+            for (; m_encoded < m_descriptors.size(); ++m_encoded) {
+                encode_descriptor(out, m_descriptors[m_encoded]);
+            }
+        }
+
+    private:
+        DescriptorRegistry() = default;
+
+        std::mutex m_mutex;
+        std::deque<Descriptor> m_descriptors; // A deque keeps references stable as it grows.
+        size_t m_encoded = 0;
+    };
+
+} // namespace
+
+const Descriptor& register_descriptor(uint8_t level, std::string_view area, const char* format_site,
+                                      std::string_view format, std::span<const ArgType> args) {
+    return DescriptorRegistry::instance().find_or_add(level, area, format_site, format, args);
+}
+
+} // namespace util::log::binary
+#endif // FNGO_BINARY_LOGS
+
+namespace util::log::async {
+
+namespace { // Anonymous namespace for internal linkage
+
+    /**
+     * @class RecordRing
+     * @brief A single-producer/single-consumer byte ring holding formatted records.
+     *
+     * Each record is an 8-byte header (payload size and target file descriptor)
+     * followed by the payload, padded to 8 bytes. A record never wraps around the
+     * end of the buffer: when it would not fit, the producer writes a wrap marker
+     * and starts again at offset zero, so the consumer can hand every payload to
+     * writev as one contiguous iovec.
+     */
+    class RecordRing {
+    public:
+        static constexpr size_t capacity = size_t{1} << 16;
+        static constexpr size_t max_record = capacity / 4;
+
+        struct Header {
+            uint32_t size;
+            int32_t fd;
+        };
+        static constexpr uint32_t wrap_marker = UINT32_MAX;
+
+        RecordRing() : m_data(std::make_unique<std::byte[]>(capacity)) {}
+
+        // Producer only. Returns false when the ring is full.
+        bool try_push(int fd, std::string_view text) {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            const size_t tail = m_tail.load(std::memory_order_acquire);
+            const size_t record = padded(sizeof(Header) + text.size());
+            const size_t offset = head & (capacity - 1);
+            const size_t until_end = capacity - offset;
+            const size_t needed = record <= until_end ? record : until_end + record;
+            if (capacity - (head - tail) < needed) {
+                return false;
+            }
+
+            size_t position = head;
+            if (record > until_end) {
+                write_header(offset, {wrap_marker, 0});
+                position += until_end;
+            }
+            const size_t start = position & (capacity - 1);
+            write_header(start, {static_cast<uint32_t>(text.size()), fd});
+            std::memcpy(&m_data[start + sizeof(Header)], text.data(), text.size());
+            m_head.store(position + record, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only: calls emit(fd, data, size) for each record published so far.
+        // The space stays reserved until release_drained(), because emit only
+        // collects pointers into the ring.
+        template<typename Emit>
+        bool drain(Emit&& emit) {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            const size_t head = m_head.load(std::memory_order_acquire);
+            m_drained_to = head;
+            if (tail == head) {
+                return false;
+            }
+            while (tail != head) {
+                const size_t offset = tail & (capacity - 1);
+                Header header;
+                std::memcpy(&header, &m_data[offset], sizeof(Header));
+                if (header.size == wrap_marker) {
+                    tail += capacity - offset;
+                    continue;
+                }
+                emit(header.fd, &m_data[offset + sizeof(Header)], header.size);
+                tail += padded(sizeof(Header) + header.size);
+            }
+            return true;
+        }
+
+        // Consumer only: makes the space of everything drained so far reusable.
+        void release_drained() { m_tail.store(m_drained_to, std::memory_order_release); }
+
+        bool empty() const noexcept {
+            return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+        }
+
+        std::atomic<bool> closed{false};
+        std::atomic<uint64_t> dropped{0};
+
+    private:
+        static constexpr size_t padded(size_t size) { return (size + 7) & ~size_t{7}; }
+
+        void write_header(size_t offset, Header header) { std::memcpy(&m_data[offset], &header, sizeof(Header)); }
+
+        alignas(cache_line_size) std::atomic<size_t> m_head{0}; // Written by the producer.
+        alignas(cache_line_size) std::atomic<size_t> m_tail{0}; // Written by the consumer.
+        size_t m_drained_to = 0;
+        std::unique_ptr<std::byte[]> m_data;
+    };
+
+
+    // Collects payloads into iovec batches and writes each batch with one writev.
+    class BatchWriter {
+    public:
+        void add(int fd, const std::byte* data, size_t size) {
+            if (fd != m_fd || m_iov.size() == IOV_MAX) {
+                flush();
+                m_fd = fd;
+            }
+            m_iov.push_back({const_cast<std::byte*>(data), size});
+        }
+
+        void flush() {
+            iovec* iov = m_iov.data();
+            auto count = static_cast<int>(m_iov.size());
+            while (count > 0) {
+                ssize_t written = ::writev(m_fd, iov, count);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break; // Nothing sensible left to do with a broken stdout.
+                }
+                // Skip fully written buffers and trim a partially written one.
+                while (count > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+                    written -= static_cast<ssize_t>(iov->iov_len);
+                    ++iov;
+                    --count;
+                }
+                if (count > 0) {
+                    iov->iov_base = static_cast<std::byte*>(iov->iov_base) + written;
+                    iov->iov_len -= static_cast<size_t>(written);
+                }
+            }
+            m_iov.clear();
+        }
+
+    private:
+        std::vector<iovec> m_iov;
+        int m_fd = 1;
+    };
+
+
+    /**
+     * @class Backend
+     * @brief Owns the per-thread rings and the thread that drains them.
+     *
+     * The backend is deliberately leaked so that it outlives every static object
+     * that might log during shutdown (the thread pool does). An atexit handler stops
+     * the writer after a final drain; later records take the synchronous path.
+     */
+    class Backend {
+    public:
+        static Backend& instance() {
+            /*NOSONAR*/ static Backend* backend = [] {
+                auto* created = new Backend();
+                std::atexit([] { instance().stop(); });
+                return created;
+            }();
+            return *backend;
+        }
+
+        bool running() const noexcept { return m_running.load(std::memory_order_acquire); }
+
+        std::shared_ptr<RecordRing> register_ring() {
+            auto ring = std::make_shared<RecordRing>();
+            std::scoped_lock lock(m_mutex);
+            m_rings.push_back(ring);
+            return ring;
+        }
+
+        void stop() {
+            if (m_running.exchange(false) && m_writer.joinable()) {
+                m_writer.join();
+            }
+        }
+
+    private:
+        Backend() {
+#ifdef FNGO_BINARY_LOGS
+            const char* path = std::getenv("FNGO_LOG_FILE");
+            m_binary_fd = ::open(path ? path : "fngo.binlog", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (m_binary_fd < 0) {
+                m_running.store(false); // Every record then takes the synchronous text path.
+                return;
+            }
+            BatchWriter header;
+            header.add(m_binary_fd, reinterpret_cast<const std::byte*>(binary::file_magic), sizeof(binary::file_magic));
+            header.flush();
+#endif
+            m_writer = std::thread([this] { run(); });
+        }
+
+        void run() {
+            BatchWriter writer;
+            bool last_pass = false;
+            while (true) {
+                const bool stopping = !running();
+                if (!drain_all(writer)) {
+                    if (last_pass) {
+                        return;
+                    }
+                    last_pass = stopping;
+                    if (!stopping) {
+                        std::this_thread::sleep_for(idle_poll_interval);
+                    }
+                }
+            }
+        }
+
+        bool drain_all(BatchWriter& writer) {
+            std::scoped_lock lock(m_mutex);
+            bool found = false;
+            for (const auto& ring : m_rings) {
+                found |= ring->drain([this, &writer](int fd, const std::byte* data, size_t size) {
+                    writer.add(target_fd(fd), data, size);
+                });
+                write_new_descriptors();
+                writer.flush();
+                ring->release_drained();
+                report_drops(*ring, writer);
+            }
+            std::erase_if(m_rings, [](const auto& ring) {
+                return ring->closed.load(std::memory_order_acquire) && ring->empty();
+            });
+            return found;
+        }
+
+        int target_fd(int fd) const noexcept {
+#ifdef FNGO_BINARY_LOGS
+            if (fd == binary::stream) {
+                return m_binary_fd;
+            }
+#endif
+            return fd;
+        }
+
+        // Descriptors must reach the file before the records that use them; the
+        // records just drained are only queued in the writer, so writing any
+        // descriptor registered up to now keeps that order.
+        void write_new_descriptors() {
+#ifdef FNGO_BINARY_LOGS
+            m_descriptor_bytes.clear();
+            binary::DescriptorRegistry::instance().encode_new(m_descriptor_bytes);
+            if (!m_descriptor_bytes.empty()) {
+                BatchWriter descriptors;
+                descriptors.add(m_binary_fd, reinterpret_cast<const std::byte*>(m_descriptor_bytes.data()), m_descriptor_bytes.size());
+                descriptors.flush();
+            }
+#endif
+        }
+
+        static void report_drops(RecordRing& ring, BatchWriter& writer) {
+            if (const uint64_t dropped = ring.dropped.exchange(0, std::memory_order_relaxed)) {
+                const std::string notice = std::format("[{:<7}] [{:^12}] {} log records dropped: buffer full.\n",
+                                                       level_to_string(Level::Warning), "Logger", dropped);
+                writer.add(2, reinterpret_cast<const std::byte*>(notice.data()), notice.size());
+                writer.flush();
+            }
+        }
+
+        static constexpr auto idle_poll_interval = std::chrono::milliseconds(1);
+
+        std::mutex m_mutex; // Guards m_rings; producers take it once, on their first record.
+        std::vector<std::shared_ptr<RecordRing>> m_rings;
+        std::atomic<bool> m_running{true};
+        int m_binary_fd = -1;
+        std::string m_descriptor_bytes;
+        std::thread m_writer;
+    };
+
+
+    // Per-thread producer state. The flag outlives the object (it is trivially
+    // destructible), so records logged while the thread is exiting take the
+    // synchronous path instead of touching a destroyed ring.
+    thread_local bool thread_state_destroyed = false;
+
+    struct ThreadState {
+        ThreadState() = default;
+        ThreadState(const ThreadState&) = delete;
+        ThreadState& operator=(const ThreadState&) = delete;
+
+        ~ThreadState() {
+            thread_state_destroyed = true;
+            if (ring) {
+                ring->closed.store(true, std::memory_order_release);
+            }
+        }
+
+        std::shared_ptr<RecordRing> ring;
+        std::string line;
+        std::string label;
+        uint64_t number = 0;
+    };
+    thread_local ThreadState thread_state;
+
+} // namespace
+
+std::string* line_buffer() {
+    if (thread_state_destroyed || !Backend::instance().running()) {
+        return nullptr;
+    }
+    return &thread_state.line;
+}
+
+bool enqueue(int fd, std::string_view record) {
+    if (record.size() > RecordRing::max_record) {
+        return false;
+    }
+    if (!thread_state.ring) {
+        thread_state.ring = Backend::instance().register_ring();
+    }
+    if (!thread_state.ring->try_push(fd, record)) {
+        thread_state.ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+std::string_view thread_label() {
+    if (thread_state.label.empty()) {
+        std::stringstream thread_id_ss;
+        thread_id_ss << std::this_thread::get_id();
+        thread_state.label = thread_id_ss.str();
+    }
+    return thread_state.label;
+}
+
+uint64_t thread_number() {
+    if (thread_state.number == 0) {
+        thread_state.number = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    }
+    return thread_state.number;
+}
+
+} // namespace util::log::async
+
+#endif // FNGO_ASYNC_LOGS
@@ -11,6 +11,21 @@
 #include <iterator>     // For std::ostream_iterator
 #include <concepts>     // For std::convertible_to
 #include <sstream>      // For std::stringstream to handle thread::id
+#include <string>
+#include <cstdint>
+
+// Deferred formatting needs the asynchronous backend to carry its records.
+#if defined(FNGO_BINARY_LOGS) && !defined(FNGO_ASYNC_LOGS)
+#define FNGO_ASYNC_LOGS
+#endif
+
+#ifdef FNGO_BINARY_LOGS
+#include "binary_log.hpp"
+#include <array>
+#include <atomic>
+#include <span>
+#include <type_traits>
+#endif
 
 // Conditionally include <stacktrace> only if enabled via the Makefile
 #ifdef USE_STACKTRACE
@@ -27,6 +42,33 @@ constexpr bool debug_logging_enabled = false;
 #endif
 
 
+// --- Compile-time configuration for the asynchronous backend ---
+#ifdef FNGO_ASYNC_LOGS
+constexpr bool async_logging_enabled = true;
+
+namespace async {
+// Implemented in logger.cpp.
+
+// The calling thread's scratch buffer for formatting a record, or nullptr when
+// the asynchronous backend cannot take records (it has shut down, or this
+// thread is exiting); callers then fall back to the synchronous path.
+std::string* line_buffer();
+
+// Hands a formatted record to the background writer without blocking or making a
+// system call. Returns false when the record must be written synchronously.
+bool enqueue(int fd, std::string_view record);
+
+// The calling thread's id, formatted once and cached.
+std::string_view thread_label();
+
+// A numeric id for the calling thread, computed once and cached.
+uint64_t thread_number();
+} // namespace async
+#else
+constexpr bool async_logging_enabled = false;
+#endif
+
+
 // Defines the severity level of a log message.
 enum class Level {
     Debug,
@@ -47,6 +89,36 @@ constexpr std::string_view level_to_string(Level level) {
     return "UNKNOWN";
 }
 
+#ifdef FNGO_BINARY_LOGS
+namespace binary {
+// Implemented in logger.cpp. Returns the descriptor for a call site, creating it
+// on first use. Descriptors live until the program exits.
+const Descriptor& register_descriptor(uint8_t level, std::string_view area, const char* format_site,
+                                      std::string_view format, std::span<const ArgType> args);
+
+// Id of the descriptor for (level, area, format, argument types). Each print
+// instantiation remembers the last few descriptors it used, so after the first
+// call from a site this is a couple of pointer and string comparisons.
+template<Level level, typename... Args>
+uint32_t descriptor_id(std::string_view area, const char* format) {
+    static constexpr std::array<ArgType, sizeof...(Args)> arg_types{arg_type_of<Args>()...};
+    /*NOSONAR*/ static std::array<std::atomic<const Descriptor*>, 4> recent{};
+    /*NOSONAR*/ static std::atomic<unsigned> next_slot{0};
+
+    for (const auto& slot : recent) {
+        const Descriptor* cached = slot.load(std::memory_order_acquire);
+        if (cached && cached->format_site == format && cached->area == area) {
+            return cached->id;
+        }
+    }
+    const Descriptor& created = register_descriptor(static_cast<uint8_t>(level), area, format, format, arg_types);
+    recent[next_slot.fetch_add(1, std::memory_order_relaxed) % recent.size()].store(&created, std::memory_order_release);
+    return created.id;
+}
+} // namespace binary
+#endif
+
+
 // --- Primary print function ---
 template<Level level, typename Fmt, typename... Args>
 void print(std::string_view area, Fmt&& fmt, Args&&... args) {
@@ -57,6 +129,53 @@ void print(std::string_view area, Fmt&& fmt, Args&&... args) {
         return;
     }
 
+#ifdef FNGO_BINARY_LOGS
+    // Deferred formatting: copy the raw arguments, format later in fngo_logdecode.
+    if (std::string* record = async::line_buffer()) {
+        record->clear();
+        if constexpr (std::is_array_v<std::remove_reference_t<Fmt>>) {
+            binary::encode_record(*record, binary::descriptor_id<level, Args...>(area, fmt), async::thread_number(), args...);
+        } else {
+            // Only string literals have a stable address to key a descriptor on;
+            // any other format string is applied now and stored as a single string.
+            std::string message;
+            if constexpr (sizeof...(args) > 0) {
+                message = std::vformat(fmt, std::make_format_args(args...));
+            } else {
+                message = std::string_view(fmt);
+            }
+            binary::encode_record(*record, binary::descriptor_id<level, std::string>(area, "{}"), async::thread_number(), message);
+        }
+        if (async::enqueue(binary::stream, *record)) {
+            return;
+        }
+        // Too large for the ring: fall back to the synchronous text path below.
+    }
+#elif defined(FNGO_ASYNC_LOGS)
+    if (std::string* line = async::line_buffer()) {
+        line->clear();
+        auto out = std::back_inserter(*line);
+        std::format_to(out, "[{:<7}] [{:^12}] [Thread:{}] ", level_to_string(level), area, async::thread_label());
+        if constexpr (sizeof...(args) > 0) {
+            std::vformat_to(out, std::forward<Fmt>(fmt), std::make_format_args(std::forward<Args>(args)...));
+        } else {
+            line->append(std::string_view(std::forward<Fmt>(fmt)));
+        }
+        line->push_back('\n');
+
+        #ifdef USE_STACKTRACE
+        if constexpr (level == Error && debug_logging_enabled) {
+            std::format_to(out, "--- Stack Trace ---\n{}-------------------\n", std::to_string(std::stacktrace::current()));
+        }
+        #endif
+
+        if (!async::enqueue(level == Error ? 2 : 1, *line)) {
+            std::osyncstream(level == Error ? std::cerr : std::cout) << *line;
+        }
+        return;
+    }
+#endif
+
     std::osyncstream synced_out(level == Error ? std::cerr : std::cout);
     
 #if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 14
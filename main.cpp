@@ -1,8 +1,14 @@
 // main.cpp
+#include "coroutine.hpp"
 #include "fire_n_go.hpp"
+#include "future.hpp"
 #include "logger.hpp"
+#include "parallel.hpp"
+#include "strand.hpp"
 #include <chrono>
+#include <functional>
 #include <stdexcept>
+#include <vector>
 
 // The TaskFailure struct is now defined in fire_n_go.hpp
 
@@ -21,29 +27,183 @@ void long_running_database_query() {
     throw util::TaskFailure("Simulated runtime failure!");
 }
 
+// A coroutine that hops onto the pool, does its work there and returns a value.
+util::task<int> count_active_users() {
+    co_await util::schedule();
+    co_return 128;
+}
+
+// A coroutine handler: awaiting suspends it instead of blocking a worker.
+util::task<void> refresh_dashboard() {
+    const int users = co_await count_active_users();
+    const int rows = co_await util::submit("Load Dashboard Rows", [users] { return users * 2; });
+    using enum util::log::Level;
+    util::log::print<Info>("Dashboard", "Dashboard refreshed: {} users, {} rows.", users, rows);
+}
+
 int main() {
     using enum util::log::Level;
 
     // The ThreadPoolManager handles initialization and shutdown automatically.
     util::log::print<Info>("Application", "Main function started. Dispatching tasks...");
 
+    // --- Task Group ---
+    // Tasks the main thread waits for below; a failure surfaces at wait().
+    util::task_group startup;
+
     // --- Standard Info Log ---
-    util::fire_and_forget("Update User Cache", [] {
+    // Background priority: runs when no critical or normal task is waiting.
+    startup.run("Update User Cache", [] {
         util::log::print<Info>("Cache", "Updating user cache...");
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    });
+    }, {.priority = util::Priority::Background});
 
     // --- Debug Log Test Case ---
-    util::fire_and_forget("Debug Info", []{
+    startup.run("Debug Info", []{
         util::log::print<Debug>("Debug", "This is a detailed debug message for developers.");
     });
 
     // --- Error Log and Stack Trace Test Case ---
-    util::fire_and_forget("Simulate Failure", failing_task);
+    startup.run("Simulate Failure", failing_task);
+
+    // --- Delayed and Periodic Tasks ---
+    // Both wait on the pool's timer thread, not on a sleeping worker.
+    util::fire_after(std::chrono::milliseconds(100), "Flush Metrics", [] {
+        util::log::print<Info>("Metrics", "Flushing metrics...");
+    });
+    util::TimerHandle heartbeat = util::fire_every(std::chrono::milliseconds(250), "Heartbeat", [] {
+        util::log::print<Info>("Health", "Service is alive.");
+    });
+
+    // --- Cancellable Task ---
+    // Polls its token: stops after two seconds, or earlier if cancelled below.
+    util::TaskHandle thumbnails = util::fire_and_forget("Rebuild Thumbnails", [](std::stop_token stop) {
+        int rebuilt = 0;
+        while (!stop.stop_requested() && rebuilt < 500) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ++rebuilt;
+        }
+        util::log::print<Info>("Thumbnails", "Rebuilt {} thumbnails.", rebuilt);
+    }, {.timeout = std::chrono::seconds(2)});
+
+    // --- Serialized Tasks per Resource ---
+    // Updates to the same user run one after another, in order, without a
+    // lock; updates to different users still run in parallel.
+    for (int user : {7, 8, 7}) {
+        util::fire_and_forget_keyed(user, "Update User Profile", [user] {
+            util::log::print<Info>("Profiles", "Updating profile of user {}...", user);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        });
+    }
+
+    // --- Result-returning Task with a Continuation ---
+    auto row_count = util::submit("Count Rows", [] { return 42; })
+        .then([](int rows) {
+            util::log::print<Info>("Database", "Query returned {} rows.", rows);
+            return rows;
+        });
 
 
+    // --- Dedicated Pool for Batch Work ---
+    // Batch jobs queue here, so they never delay the interactive tasks above.
+    // Its workers stay on their NUMA node, next to the data they index, and it
+    // adds workers while its jobs queue up or block, up to four.
+    util::ThreadPool batch_pool({.name = "batch", .threads = 2, .max_threads = 4, .affinity = util::Affinity::Node});
+    util::task_group indexing(batch_pool);
+    indexing.run("Rebuild Search Index", [] {
+        util::log::print<Info>("Search", "Rebuilding search index...");
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    });
+    // Refresh requests come in bursts; one that arrives while a refresh is still
+    // queued replaces it, instead of queueing another run of the same work.
+    for (int request = 1; request <= 100; ++request) {
+        util::fire_and_forget(batch_pool, "Refresh Exchange Rates", [request] {
+            util::log::print<Info>("Rates", "Refreshing exchange rates for request {}...", request);
+        }, {.coalesce = util::Coalesce::KeepLast});
+    }
+
+    // --- Rate-limited Database Access ---
+    // The pool starts at most two queries a second, two at once after a quiet
+    // spell; callers just submit, and the excess waits on the timer thread.
+    util::ThreadPool database_pool({.name = "database", .threads = 4,
+        .rate_limits = {{.task_name = "Database Query", .per_second = 2, .burst = 2}}});
+    for (int query = 0; query < 4; ++query) {
+        util::fire_and_forget(database_pool, "Database Query", long_running_database_query);
+    }
+
+    // --- Retrying Transient Failures ---
+    // The first two runs hit a dropped connection. Each retry waits out its
+    // backoff on the timer thread, not on a worker; a task that still fails
+    // after four runs ends up with the dead-letter handler.
+    const auto database_retry = std::make_shared<const util::RetryPolicy>(util::RetryPolicy{
+        .max_attempts = 4,
+        .initial_backoff = std::chrono::milliseconds(50),
+        .on_dead_letter = [](const util::DeadLetter& letter) {
+            util::log::print<Error>("Database", "Giving up on '{}' after {} attempt(s).", letter.task_name, letter.attempts);
+        }});
+    util::fire_and_forget(database_pool, "Sync Orders", [attempt = 0]() mutable {
+        if (++attempt < 3) {
+            throw util::TaskFailure("connection reset by peer");
+        }
+        util::log::print<Info>("Database", "Orders synced on attempt {}.", attempt);
+    }, {.retry = database_retry});
+
+    // --- Deadline Scheduling ---
+    // A quote is useless once the client has given up on it, so this pool runs
+    // the most urgent one first and sheds those that can no longer make it.
+    util::ThreadPool quote_pool({.name = "quotes", .threads = 1, .discipline = util::QueueDiscipline::EarliestDeadline});
+    const auto quotes_start = util::TaskClock::now();
+    util::fire_and_forget(quote_pool, "Price Bulk Order", [] {
+        util::log::print<Info>("Quotes", "Pricing bulk order...");
+    });
+    util::fire_and_forget(quote_pool, "Price Limit Order", [] {
+        util::log::print<Info>("Quotes", "Pricing limit order...");
+    }, {.deadline = quotes_start + std::chrono::milliseconds(60)});
+    util::fire_and_forget(quote_pool, "Price Market Order", [] {
+        util::log::print<Info>("Quotes", "Pricing market order...");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }, {.deadline = quotes_start + std::chrono::milliseconds(50)});
+
+    // --- Data-parallel Loops ---
+    // The main thread works through the range alongside the pool's workers.
+    std::vector<int> order_totals(100'000);
+    util::parallel_for(0, order_totals.size(), 1024, [&order_totals](size_t i) {
+        order_totals[i] = static_cast<int>(i % 97);
+    });
+    const long revenue = util::parallel_reduce(0, order_totals.size(), 1024, 0L,
+        [&order_totals](size_t i) { return long{order_totals[i]}; }, std::plus<>{});
+    util::log::print<Info>("Reports", "Revenue over {} orders: {}.", order_totals.size(), revenue);
+
+    // --- Coroutine Handler ---
+    // A thread outside the pool may block on a coroutine; spawn() would run it detached.
     util::log::print<Info>("Application", "Main thread is continuing with other work...");
-    std::this_thread::sleep_for(std::chrono::seconds(3));
+    util::sync_wait(refresh_dashboard());
+
+    try {
+        startup.wait(); // Runs queued tasks on this thread instead of sleeping.
+    } catch (const util::TaskFailure& e) {
+        util::log::print<Error>("Application", "Startup task failed: {}", e.what());
+    }
+    indexing.wait();
+    util::log::print<Info>("Rates", "{} refresh request(s) merged into queued ones.", batch_pool.coalesced_count());
+    util::log::print<Info>("Application", "Row count future resolved to {}.", row_count.get());
+    heartbeat.cancel();
+    util::log::print<Info>("Quotes", "{} quote(s) missed their deadline.", quote_pool.expired_count());
+    database_pool.shutdown();
+
+    // --- Per-task Latency ---
+    for (const util::TaskLatency& latency : util::task_latency_snapshot()) {
+        util::log::print<Info>("Latency", "'{}': {} runs, queue wait p50 {} us, run time p99 {} us.",
+            latency.name, latency.run_time.count(),
+            latency.queue_wait.percentile(50).count() / 1000, latency.run_time.percentile(99).count() / 1000);
+    }
+
+    thumbnails.cancel(); // No-op if the timeout already stopped it.
+
+    // --- Graceful Shutdown ---
+    // Give queued work up to two seconds to finish instead of discarding it at exit.
+    const size_t dropped = util::shutdown_thread_pool(util::ShutdownMode::DrainUntilDeadline, std::chrono::seconds(2));
+    util::log::print<Info>("Application", "Global pool drained, {} task(s) dropped.", dropped);
 
     util::log::print<Info>("Application", "Main function is about to exit. Pool shutdown will be automatic.");
     return 0;
@@ -0,0 +1,425 @@
+// parallel.hpp
+#pragma once
+
+#include "fire_n_go.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+/**
+ * @class JoinState
+ * @brief Bookkeeping shared by the tasks of one fork-join operation: a
+ * parallel_for, a parallel_reduce or a task_group.
+ *
+ * Counts the tasks still outstanding and keeps the first exception any of
+ * them threw; once one has failed, loop parts stop at their next chunk. Tasks
+ * hold it through a JoinPart, so the last one to finish may still touch it
+ * after the waiting thread has returned.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class JoinState {
+public:
+    explicit JoinState(ThreadPool& pool) noexcept : m_pool(pool) {}
+
+    JoinState(const JoinState&) = delete;
+    JoinState& operator=(const JoinState&) = delete;
+
+    ThreadPool& pool() const noexcept { return m_pool; }
+
+    bool failed() const noexcept { return m_failed.load(std::memory_order_relaxed); }
+
+    // Keeps error if it is the first one and returns whether it was.
+    bool fail(std::exception_ptr error) noexcept {
+        if (m_failed.exchange(true, std::memory_order_relaxed)) {
+            return false;
+        }
+        m_error = std::move(error); // Published to the waiter by finish_part().
+        return true;
+    }
+
+    void add_part() noexcept { m_pending.fetch_add(1, std::memory_order_relaxed); }
+
+    void finish_part() noexcept {
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            const std::scoped_lock lock(m_mutex);
+            m_done.notify_all();
+        }
+    }
+
+    // Runs queued pool tasks on this thread until every part has finished, then
+    // rethrows the first exception, if any, and forgets it. Blocks only when
+    // there is nothing to run, and then never for long: a part held back by a
+    // rate limit or queued on another node becomes runnable without anything
+    // finishing, and this thread may be the only one left to run it.
+    void wait() {
+        std::chrono::microseconds backoff = min_backoff;
+        while (m_pending.load(std::memory_order_acquire) != 0) {
+            if (m_pool.run_pending_task()) {
+                backoff = min_backoff;
+                continue;
+            }
+            std::unique_lock lock(m_mutex);
+            if (m_done.wait_for(lock, backoff, [this] { return m_pending.load(std::memory_order_acquire) == 0; })) {
+                break;
+            }
+            backoff = std::min(backoff * 2, max_backoff);
+        }
+        if (m_failed.load(std::memory_order_relaxed)) {
+            std::exception_ptr error = std::exchange(m_error, nullptr);
+            m_failed.store(false, std::memory_order_relaxed);
+            std::rethrow_exception(std::move(error));
+        }
+    }
+
+    /**
+     * @brief Works through [first, last) with lazy binary splitting.
+     *
+     * The range is consumed grain by grain from the left. Before each grain,
+     * if the calling thread has no queued work left, which is the case when
+     * other threads have taken what it split off before, the right half of what
+     * remains is split off through spawn_right(mid, last). Splitting thus
+     * follows actual demand instead of a chunk count fixed up front, and a
+     * busy pool costs one emptiness check per grain.
+     */
+    template<typename Index, typename Chunk, typename SpawnRight>
+    void split_lazily(Index first, Index last, size_t grain, Chunk&& chunk, SpawnRight&& spawn_right) {
+        try {
+            while (first < last && !failed()) {
+                const auto remaining = static_cast<size_t>(last - first);
+                if (remaining > grain && m_pool.local_queue_empty()) {
+                    const Index mid = first + static_cast<Index>(remaining / 2);
+                    spawn_right(mid, last);
+                    last = mid;
+                    continue;
+                }
+                const Index chunk_last = first + static_cast<Index>(std::min(grain, remaining));
+                chunk(first, chunk_last);
+                first = chunk_last;
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    }
+
+private:
+    // How long wait() sleeps before looking for work again, doubling while it finds none.
+    static constexpr std::chrono::microseconds min_backoff{50};
+    static constexpr std::chrono::microseconds max_backoff{5'000};
+
+    ThreadPool& m_pool;
+    std::mutex m_mutex; // Guards nothing; pairs m_done with m_pending.
+    std::condition_variable m_done;
+    std::atomic<size_t> m_pending{0};
+    std::atomic<bool> m_failed{false};
+    std::exception_ptr m_error;
+};
+
+
+/**
+ * @class JoinPart
+ * @brief The claim of one queued task on its JoinState.
+ *
+ * Captured by the task; counts the task as outstanding from construction
+ * until finish(). A task the pool destroys without running it, because it
+ * was rejected, dropped by OverflowPolicy::DropOldest or left over at
+ * shutdown, still ends its claim, and the waiter gets a TaskFailure instead
+ * of waiting forever.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class JoinPart {
+public:
+    explicit JoinPart(std::shared_ptr<JoinState> state) noexcept : m_state(std::move(state)) {
+        m_state->add_part();
+    }
+
+    JoinPart(JoinPart&&) noexcept = default;
+    JoinPart& operator=(JoinPart&&) = delete;
+
+    ~JoinPart() {
+        if (m_state) {
+            m_state->fail(std::make_exception_ptr(TaskFailure("a task was discarded by the pool before it ran")));
+            m_state->finish_part();
+        }
+    }
+
+    const std::shared_ptr<JoinState>& state() const noexcept { return m_state; }
+
+    void finish() noexcept {
+        std::shared_ptr<JoinState> state = std::move(m_state);
+        state->finish_part();
+    }
+
+private:
+    std::shared_ptr<JoinState> m_state;
+};
+
+
+/**
+ * @brief Runs one part of a parallel_for and whatever it splits off.
+ *
+ * @note This function is an internal implementation detail.
+ */
+template<typename Index, typename Fn>
+void parallel_for_part(const std::shared_ptr<JoinState>& loop, Index first, Index last, size_t grain, const Fn& fn) {
+    loop->split_lazily(first, last, grain,
+        [&fn](Index chunk_first, Index chunk_last) {
+            for (Index i = chunk_first; i < chunk_last; ++i) {
+                std::invoke(fn, i);
+            }
+        },
+        [&loop, grain, &fn](Index mid, Index right_last) {
+            // The caller waits for every part, so fn outlives them all.
+            // Already admitted work: enqueue, since a bounded pool must not shed it.
+            loop->pool().enqueue([part = JoinPart(loop), mid, right_last, grain, fn = &fn]() mutable {
+                parallel_for_part(part.state(), mid, right_last, grain, *fn);
+                part.finish();
+            });
+        });
+}
+
+/**
+ * @brief Calls fn(i) for every i in [first, last), spread over the pool's workers.
+ *
+ * The calling thread works on the range too and, once its own share is done,
+ * runs queued pool tasks until the whole range is; it returns when every call
+ * has returned. Parts are split off on demand (lazy binary splitting), never
+ * smaller than grain indices, so grain only needs to be large enough to
+ * amortise an emptiness check, not tuned to the thread count. No thread is
+ * created, and the parts are not logged or timed individually.
+ *
+ * Calling it from inside a pool task is fine: the waiting worker keeps
+ * running tasks instead of blocking its slot in the pool.
+ *
+ * fn is invoked concurrently on a shared instance, which is why it is invoked
+ * as const. If a call throws, the remaining chunks are skipped and the first
+ * exception is rethrown here.
+ *
+ * @param pool The pool whose workers share the loop.
+ * @param first, last The index range.
+ * @param grain The smallest number of indices handed out as one part; 0 counts as 1.
+ * @param fn The loop body.
+ */
+template<std::integral First, std::integral Last, typename Fn>
+    requires std::invocable<const Fn&, std::common_type_t<First, Last>>
+void parallel_for(ThreadPool& pool, First first, Last last, size_t grain, const Fn& fn) {
+    using Index = std::common_type_t<First, Last>;
+    auto loop = std::make_shared<JoinState>(pool);
+    parallel_for_part(loop, static_cast<Index>(first), static_cast<Index>(last), std::max<size_t>(grain, 1), fn);
+    loop->wait();
+}
+
+// parallel_for on the global thread pool.
+template<std::integral First, std::integral Last, typename Fn>
+    requires std::invocable<const Fn&, std::common_type_t<First, Last>>
+void parallel_for(First first, Last last, size_t grain, const Fn& fn) {
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "parallel_for called but thread pool is not available; running it serially.");
+        for (auto i = static_cast<std::common_type_t<First, Last>>(first); i < last; ++i) {
+            std::invoke(fn, i);
+        }
+        return;
+    }
+    parallel_for(*pool_instance, first, last, grain, fn);
+}
+
+
+/**
+ * @brief The partial result of one parallel_reduce part.
+ *
+ * A part folds its own chunks into value and records the parts it splits off
+ * as children, rightmost first. Joining value with the children's results in
+ * reverse order therefore restores index order, so combine only has to be
+ * associative, not commutative.
+ *
+ * @note This struct is an internal implementation detail.
+ */
+template<typename T>
+struct ReducePart {
+    T value;
+    std::vector<std::unique_ptr<ReducePart>> children;
+
+    template<typename Combine>
+    T join(const Combine& combine) && {
+        T result = std::move(value);
+        for (auto child = children.rbegin(); child != children.rend(); ++child) {
+            result = std::invoke(combine, std::move(result), std::move(**child).join(combine));
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Runs one part of a parallel_reduce and whatever it splits off.
+ *
+ * @note This function is an internal implementation detail.
+ */
+template<typename Index, typename T, typename Map, typename Combine>
+void parallel_reduce_part(const std::shared_ptr<JoinState>& loop, ReducePart<T>& part, Index first, Index last,
+                          size_t grain, const T& identity, const Map& map, const Combine& combine) {
+    loop->split_lazily(first, last, grain,
+        [&part, &map, &combine](Index chunk_first, Index chunk_last) {
+            for (Index i = chunk_first; i < chunk_last; ++i) {
+                part.value = std::invoke(combine, std::move(part.value), std::invoke(map, i));
+            }
+        },
+        [&](Index mid, Index right_last) {
+            // Only this part's thread touches its children until the caller joins them.
+            ReducePart<T>* child = part.children.emplace_back(std::make_unique<ReducePart<T>>(identity)).get();
+            loop->pool().enqueue([part = JoinPart(loop), child, mid, right_last, grain,
+                                  identity = &identity, map = &map, combine = &combine]() mutable {
+                parallel_reduce_part(part.state(), *child, mid, right_last, grain, *identity, *map, *combine);
+                part.finish();
+            });
+        });
+}
+
+/**
+ * @brief Folds map(i) over every i in [first, last) with combine, spread over the pool's workers.
+ *
+ * Scheduling, helping and exceptions work as in parallel_for. Every part
+ * starts from a copy of identity and partial results are joined in index
+ * order, so the result equals the serial left fold for any associative
+ * combine, e.g. string concatenation; floating-point sums may differ from the
+ * serial sum in the last bits because the grouping differs.
+ *
+ * @param identity The neutral element of combine; also the result of an empty range.
+ * @param map Turns an index into a value; invoked concurrently, as const.
+ * @param combine Joins two values, left then right; invoked concurrently, as const.
+ */
+template<std::integral First, std::integral Last, typename T, typename Map, typename Combine>
+    requires std::invocable<const Map&, std::common_type_t<First, Last>> &&
+             std::convertible_to<std::invoke_result_t<const Combine&, T, std::invoke_result_t<const Map&, std::common_type_t<First, Last>>>, T>
+T parallel_reduce(ThreadPool& pool, First first, Last last, size_t grain, T identity, const Map& map, const Combine& combine) {
+    using Index = std::common_type_t<First, Last>;
+    auto loop = std::make_shared<JoinState>(pool);
+    ReducePart<T> root{identity, {}};
+    parallel_reduce_part(loop, root, static_cast<Index>(first), static_cast<Index>(last), std::max<size_t>(grain, 1),
+                         identity, map, combine);
+    loop->wait();
+    return std::move(root).join(combine);
+}
+
+// parallel_reduce on the global thread pool.
+template<std::integral First, std::integral Last, typename T, typename Map, typename Combine>
+    requires std::invocable<const Map&, std::common_type_t<First, Last>> &&
+             std::convertible_to<std::invoke_result_t<const Combine&, T, std::invoke_result_t<const Map&, std::common_type_t<First, Last>>>, T>
+T parallel_reduce(First first, Last last, size_t grain, T identity, const Map& map, const Combine& combine) {
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "parallel_reduce called but thread pool is not available; running it serially.");
+        T result = std::move(identity);
+        for (auto i = static_cast<std::common_type_t<First, Last>>(first); i < last; ++i) {
+            result = std::invoke(combine, std::move(result), std::invoke(map, i));
+        }
+        return result;
+    }
+    return parallel_reduce(*pool_instance, first, last, grain, std::move(identity), map, combine);
+}
+
+
+/**
+ * @class task_group
+ * @brief A set of tasks that can be waited for together.
+ *
+ * ```
+ * util::task_group group;
+ * group.run("Load Users", load_users);
+ * group.run("Load Orders", load_orders);
+ * group.wait(); // Both have finished; rethrows the first exception either threw.
+ * ```
+ *
+ * Tasks are queued, logged and timed like fire_and_forget tasks and may
+ * themselves run more tasks in the group. wait() does not just block: the
+ * waiting thread runs queued pool tasks, its group's or others', until the
+ * group is done, so a task that waits for a nested group keeps its worker
+ * busy and cannot starve the pool into a deadlock.
+ *
+ * The first exception a task throws is kept and rethrown by wait(); later
+ * ones are logged like fire_and_forget failures. A task the pool rejects or
+ * discards makes wait() throw a TaskFailure. After wait() the group may be
+ * reused. Destroying a group waits for its tasks and logs an exception that
+ * wait() did not get to rethrow.
+ */
+class task_group {
+public:
+    explicit task_group(ThreadPool& pool) : m_state(std::make_shared<JoinState>(pool)) {}
+
+    // A group on the global thread pool. Throws TaskFailure if there is none.
+    task_group() : task_group(global_pool()) {}
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    ~task_group() {
+        try {
+            m_state->wait();
+        } catch (...) {
+            log_task_exception("task_group", std::current_exception());
+        }
+    }
+
+    /**
+     * @brief Queues a task in the group, subject to the pool's bound and overflow
+     * policy, and to its RateLimit for the task's name.
+     *
+     * @param task_name A descriptive name for the task, used for logging.
+     * @param task The callable object to be executed.
+     * @param options Scheduling options such as the task's Priority.
+     */
+    template<typename Callable>
+    void run(std::string_view task_name, Callable&& task, TaskOptions options = {})
+        requires std::invocable<Callable&&>
+    {
+        ThreadPool& pool = m_state->pool();
+        const EnqueueResult queued = pool.try_enqueue_named(task_name, [part = JoinPart(m_state), name = TaskName(task_name),
+                                                                        work = std::forward<Callable>(task), enqueued = TaskClock::now()]() mutable {
+            using enum log::Level;
+            const auto started = TaskClock::now();
+            log::print<Info>("TaskRunner", "Starting task: '{}'", name.view());
+            try {
+                std::invoke(std::move(work));
+                log::print<Info>("TaskRunner", "Finished task: '{}'", name.view());
+            } catch (...) {
+                if (!part.state()->fail(std::current_exception())) {
+                    log_task_exception(name.view(), std::current_exception());
+                }
+            }
+            part.state()->pool().record_latency(name.view(), started - enqueued, TaskClock::now() - started);
+            part.finish();
+        }, options, SubmitKind::Exclusive);
+        log_rejected_task(pool, task_name, queued);
+    }
+
+    // Runs pool tasks on this thread until every task in the group has
+    // finished, then rethrows the first exception one of them threw.
+    void wait() { m_state->wait(); }
+
+private:
+    static ThreadPool& global_pool() {
+        ThreadPool* pool_instance = get_thread_pool_instance();
+        if (!pool_instance) {
+            log::print<log::Level::Error>("TaskRunner", "task_group created but thread pool is not available.");
+            throw TaskFailure("thread pool is not available");
+        }
+        return *pool_instance;
+    }
+
+    std::shared_ptr<JoinState> m_state;
+};
+
+} // namespace util
@@ -0,0 +1,89 @@
+// rate_limiter.hpp
+#pragma once
+
+#include "task_stats.hpp" // For TaskClock
+#include <algorithm>
+#include <atomic>
+#include <cmath>       // For std::llround
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace util {
+
+/**
+ * @brief What happens to a task submitted while its name is over its RateLimit.
+ */
+enum class RateLimitPolicy : uint8_t {
+    Delay,   // The task waits, on the pool's timer thread, until it is within the limit.
+    Reject,  // The task is rejected, as by a full pool.
+    Coalesce // Like Delay, but a task of that name still waiting, for the limit or for a worker, absorbs it (see Coalesce).
+};
+
+/**
+ * @brief A token-bucket limit on how often tasks of one name may start, meant
+ * for designated initializers:
+ * `{.task_name = "Database Query", .per_second = 20, .burst = 5}`.
+ *
+ * Tokens refill at per_second; the bucket holds up to burst of them, so after
+ * an idle spell up to burst tasks start back to back.
+ */
+struct RateLimit {
+    std::string task_name;
+    double per_second = 1.0;
+    size_t burst = 1;
+    RateLimitPolicy policy = RateLimitPolicy::Delay;
+};
+
+
+/**
+ * @class RateLimiter
+ * @brief The token bucket of one RateLimit, kept as a single atomic timestamp.
+ *
+ * Uses the generic cell rate algorithm: instead of a token count and a refill
+ * time, it keeps the time at which the bucket will be full again, and a task
+ * takes a token by moving that time one interval forward with a
+ * compare-and-swap. Admission is therefore lock-free, and a delayed task
+ * reserves its slot right away, so delayed tasks start in submission order
+ * without piling up on the same instant.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class RateLimiter {
+public:
+    explicit RateLimiter(const RateLimit& limit) noexcept
+        : m_policy(limit.policy),
+          m_interval(std::max<int64_t>(1, std::llround(1e9 / limit.per_second))),
+          m_tolerance(m_interval * static_cast<int64_t>(std::max<size_t>(1, limit.burst) - 1)) {}
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    RateLimitPolicy policy() const noexcept { return m_policy; }
+
+    // Takes a token and returns when the task may start: `now` if the bucket
+    // had one, else the time one will be free. Without `wait`, returns
+    // nullopt instead of reserving a future token.
+    std::optional<TaskClock::time_point> acquire(TaskClock::time_point now, bool wait) noexcept {
+        const int64_t at = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+        int64_t full_at = m_full_at.load(std::memory_order_relaxed);
+        while (true) {
+            const int64_t start = std::max(at, full_at - m_tolerance);
+            if (start > at && !wait) {
+                return std::nullopt;
+            }
+            if (m_full_at.compare_exchange_weak(full_at, std::max(full_at, at) + m_interval, std::memory_order_relaxed)) {
+                return TaskClock::time_point(std::chrono::duration_cast<TaskClock::duration>(std::chrono::nanoseconds(start)));
+            }
+        }
+    }
+
+private:
+    const RateLimitPolicy m_policy;
+    const int64_t m_interval;  // Nanoseconds per token.
+    const int64_t m_tolerance; // How far ahead of now m_full_at may be for a token to be free.
+    std::atomic<int64_t> m_full_at{0}; // Nanoseconds on TaskClock; at or before now: the bucket is full.
+};
+
+} // namespace util
@@ -0,0 +1,216 @@
+// strand.hpp
+#pragma once
+
+#include "fire_n_go.hpp"
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <functional>  // For std::hash
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+/**
+ * @class StrandState
+ * @brief The queue of one strand and the count of tasks it holds.
+ *
+ * A post that takes the count from zero schedules a drain task on the pool;
+ * every other post only queues. The drain runs the queued tasks one by one
+ * and stops when the count drops back to zero, so at most one of them runs at
+ * any time, and in the order they were posted. After max_batch tasks it
+ * queues itself again, so that a busy strand shares its worker with the rest
+ * of the pool instead of holding on to it.
+ *
+ * A task held back by its RateLimit carries the time it may start. When the
+ * drain reaches it early, the drain sets it aside and queues itself again on
+ * the pool's timer thread for that time, so the strand waits without
+ * occupying a worker.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class StrandState {
+public:
+    explicit StrandState(ThreadPool& pool) noexcept : m_pool(pool) {}
+
+    StrandState(const StrandState&) = delete;
+    StrandState& operator=(const StrandState&) = delete;
+
+    ThreadPool& pool() const noexcept { return m_pool; }
+
+    static void post(const std::shared_ptr<StrandState>& self, unique_task&& task, TaskClock::time_point not_before = {}) {
+        self->m_tasks.try_push(Entry{std::move(task), not_before});
+        // The task is queued before it is counted, so the drain always finds it.
+        if (self->m_pending.fetch_add(1, std::memory_order_acq_rel) == 0) {
+            schedule(self);
+        }
+    }
+
+private:
+    static constexpr size_t max_batch = 64;
+
+    struct Entry {
+        unique_task task;
+        TaskClock::time_point not_before; // Set by the task's RateLimit.
+    };
+
+    static void schedule(std::shared_ptr<StrandState> self) {
+        // A continuation of tasks already accepted, so not subject to the queue bound.
+        ThreadPool& pool = self->m_pool;
+        pool.enqueue([self = std::move(self)] { drain(self); });
+    }
+
+    static void drain(const std::shared_ptr<StrandState>& self) {
+        for (size_t ran = 0; ran < max_batch; ++ran) {
+            Entry& next = self->m_next;
+            if (!next.task) {
+                self->m_tasks.try_pop(next);
+            }
+            if (const auto now = TaskClock::now(); next.not_before > now) {
+                // Refused only once the pool's timers have stopped: run it now rather than lose the strand.
+                if (!self->m_pool.try_enqueue_after(next.not_before - now, [self] { drain(self); })) {
+                    next.not_before = {};
+                    schedule(self);
+                }
+                return;
+            }
+            unique_task task = std::move(next.task);
+            task();
+            if (self->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                return;
+            }
+        }
+        schedule(self);
+    }
+
+    ThreadPool& m_pool;
+    LockedTaskQueue<Entry> m_tasks;
+    Entry m_next; // Taken from m_tasks but not due yet; only the drain touches it.
+    std::atomic<size_t> m_pending{0};
+};
+
+
+/**
+ * @class strand
+ * @brief Runs its tasks on a ThreadPool one at a time, in the order they were posted.
+ *
+ * A lighter alternative to a mutex inside every task: tasks that must not
+ * overlap, e.g. updates to the same user, are posted to one strand, and a
+ * task waiting for its turn sits in the strand's queue instead of blocking a
+ * worker. Tasks of different strands still run in parallel. Tasks are logged
+ * and timed like fire_and_forget tasks; their queue wait includes the time
+ * spent behind earlier tasks of the strand.
+ *
+ * Posting is never subject to the pool's queue bound. A RateLimit the pool
+ * has for a task's name applies when the task is posted: a delayed task also
+ * holds up the tasks posted after it to the same strand, and one the limit
+ * rejects is dropped with a warning. RateLimitPolicy::Coalesce delays like
+ * Delay, since merging would reorder the strand. Destroying a strand does not
+ * cancel the tasks it has queued.
+ */
+class strand {
+public:
+    explicit strand(ThreadPool& pool) : m_state(std::make_shared<StrandState>(pool)) {}
+
+    // A strand on the global thread pool. Throws TaskFailure if there is none.
+    strand() : strand(global_pool()) {}
+
+    /**
+     * @brief Queues a task to run after every task posted to this strand before it.
+     *
+     * @param task_name A descriptive name for the task, used for logging.
+     * @param task The callable object to be executed.
+     */
+    template<typename Callable>
+    void post(std::string_view task_name, Callable&& task)
+        requires std::invocable<Callable&&>
+    {
+        ThreadPool& pool = m_state->pool();
+        TaskClock::time_point not_before{};
+        if (RateLimiter* limiter = pool.rate_limiter(task_name)) {
+            const auto start = limiter->acquire(TaskClock::now(), limiter->policy() != RateLimitPolicy::Reject);
+            if (!start) {
+                log_rejected_task(pool, task_name, EnqueueResult::RateLimited);
+                return;
+            }
+            not_before = *start;
+        }
+        StrandState::post(m_state, unique_task(make_logged_task(&pool, task_name, std::forward<Callable>(task))), not_before);
+    }
+
+private:
+    static ThreadPool& global_pool() {
+        ThreadPool* pool_instance = get_thread_pool_instance();
+        if (!pool_instance) {
+            log::print<log::Level::Error>("TaskRunner", "strand created but thread pool is not available.");
+            throw TaskFailure("thread pool is not available");
+        }
+        return *pool_instance;
+    }
+
+    std::shared_ptr<StrandState> m_state;
+};
+
+
+/**
+ * @class strand_set
+ * @brief A fixed set of strands on one pool, picked by hashing a key.
+ *
+ * Tasks posted with equal keys never overlap and run in posting order; tasks
+ * with different keys usually run in parallel, unless their keys share a
+ * strand. More strands mean fewer such collisions.
+ */
+class strand_set {
+public:
+    static constexpr size_t default_size = 64;
+
+    explicit strand_set(ThreadPool& pool, size_t size = default_size) {
+        m_strands.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            m_strands.emplace_back(pool);
+        }
+    }
+
+    template<typename Key>
+    strand& for_key(const Key& key) {
+        return m_strands[std::hash<Key>{}(key) % m_strands.size()];
+    }
+
+    template<typename Key, typename Callable>
+    void post(const Key& key, std::string_view task_name, Callable&& task)
+        requires std::invocable<Callable&&>
+    {
+        for_key(key).post(task_name, std::forward<Callable>(task));
+    }
+
+private:
+    std::vector<strand> m_strands;
+};
+
+
+/**
+ * @brief Runs a task on the global thread pool, after and never alongside
+ * any earlier task given the same key.
+ *
+ * Keys hash into strand_set::default_size strands on the global pool.
+ *
+ * @param key Identifies the resource the task works on, e.g. a user id.
+ * @param task_name A descriptive name for the task, used for logging.
+ * @param task The callable object to be executed.
+ */
+template<typename Key, typename Callable>
+void fire_and_forget_keyed(const Key& key, std::string_view task_name, Callable&& task)
+    requires std::invocable<Callable&&>
+{
+    ThreadPool* pool_instance = get_thread_pool_instance();
+    if (!pool_instance) {
+        log::print<log::Level::Error>("TaskRunner", "fire_and_forget_keyed called but thread pool is not available.");
+        return;
+    }
+    /*NOSONAR*/ static strand_set global_strands(*pool_instance);
+    global_strands.post(key, task_name, std::forward<Callable>(task));
+}
+
+} // namespace util
@@ -0,0 +1,167 @@
+// task_coalescer.hpp
+#pragma once
+
+#include "cache_line.hpp"
+#include "task_stats.hpp" // For TaskNameHash
+#include "unique_task.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>  // For std::equal_to
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace util {
+
+/**
+ * @brief What happens to a task submitted while one of the same name is queued.
+ *
+ * Meant for idempotent jobs, such as a cache refresh, that are submitted far
+ * more often than they can usefully run.
+ */
+enum class Coalesce : uint8_t {
+    None,      // Every submission runs.
+    KeepFirst, // The new submission is dropped; the queued task runs.
+    KeepLast   // The new submission replaces the queued task's callable, in the queued task's place.
+};
+
+
+/**
+ * @class TaskCoalescer
+ * @brief The coalescing tasks of one ThreadPool that are queued but not yet started, by name.
+ *
+ * A hash map split into shard_count shards, each with its own lock, picked by
+ * the name's hash: submissions of different names rarely touch the same lock,
+ * and each lock is held only for one map lookup. An entry is added before its
+ * task is queued, published once the pool has accepted the task, and removed
+ * when a worker takes its callable, so the map only ever holds what is
+ * waiting in the pool's queues. Only a published entry absorbs later
+ * submissions: until then the pool may still reject its task, and work merged
+ * into it would be lost with it.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class TaskCoalescer {
+public:
+    // One queued task. Its callable and flag are guarded by the lock of its name's shard.
+    struct Entry {
+        std::string name;
+        unique_task task;
+        bool published = false; // The pool has accepted the task.
+    };
+
+    TaskCoalescer() = default;
+    TaskCoalescer(const TaskCoalescer&) = delete;
+    TaskCoalescer& operator=(const TaskCoalescer&) = delete;
+
+    // Returns a new entry holding `task`, which the caller must queue, then
+    // publish() once the pool has accepted it, and later take(); or nullptr if
+    // a task of that name is already queued, in which case `task` is left for
+    // the caller to destroy: the new one under KeepFirst, the one it replaced
+    // under KeepLast. While the queued entry is not yet published, the new
+    // entry is kept out of the map and its task runs on its own.
+    std::shared_ptr<Entry> add(std::string_view name, unique_task& task, Coalesce mode) {
+        Shard& shard = shard_for(name);
+        const std::scoped_lock lock(shard.mutex);
+        const auto queued = shard.entries.find(name);
+        if (queued != shard.entries.end() && queued->second->published) {
+            if (mode == Coalesce::KeepLast) {
+                std::swap(queued->second->task, task);
+            }
+            ++shard.merged;
+            return nullptr;
+        }
+        auto entry = std::make_shared<Entry>(std::string(name), std::move(task));
+        if (queued == shard.entries.end()) {
+            shard.entries.emplace(entry->name, entry);
+        }
+        return entry;
+    }
+
+    // Lets later submissions merge into the entry. Does nothing if its task
+    // has already been taken, e.g. because it ran on the submitting thread.
+    void publish(Entry& entry) {
+        Shard& shard = shard_for(entry.name);
+        const std::scoped_lock lock(shard.mutex);
+        if (const auto queued = shard.entries.find(entry.name); queued != shard.entries.end() && queued->second.get() == &entry) {
+            entry.published = true;
+        }
+    }
+
+    // Removes the entry, so that later submissions queue a new task, and
+    // returns its callable. Called once per entry, when its task starts or is
+    // discarded.
+    unique_task take(Entry& entry) {
+        Shard& shard = shard_for(entry.name);
+        const std::scoped_lock lock(shard.mutex);
+        if (const auto queued = shard.entries.find(entry.name); queued != shard.entries.end() && queued->second.get() == &entry) {
+            shard.entries.erase(queued);
+        }
+        return std::move(entry.task);
+    }
+
+    // Submissions merged into an already queued task so far.
+    uint64_t merged_count() const {
+        uint64_t total = 0;
+        for (const Shard& shard : m_shards) {
+            const std::scoped_lock lock(shard.mutex);
+            total += shard.merged;
+        }
+        return total;
+    }
+
+private:
+    static constexpr size_t shard_count = 32;
+
+    struct alignas(cache_line_size) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Entry>, TaskNameHash, std::equal_to<>> entries;
+        uint64_t merged = 0;
+    };
+
+    Shard& shard_for(std::string_view name) noexcept {
+        return m_shards[TaskNameHash{}(name) % shard_count];
+    }
+
+    std::array<Shard, shard_count> m_shards;
+};
+
+
+/**
+ * @class CoalescedRun
+ * @brief The task a ThreadPool queues for one TaskCoalescer entry.
+ *
+ * Runs whatever callable the entry holds by the time a worker gets to it.
+ * Removes the entry even if it never runs, e.g. when the pool discards it at
+ * shutdown, so that a lost task does not swallow later submissions.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class CoalescedRun {
+public:
+    CoalescedRun(TaskCoalescer& coalescer, std::shared_ptr<TaskCoalescer::Entry> entry) noexcept
+        : m_coalescer(&coalescer), m_entry(std::move(entry)) {}
+    CoalescedRun(CoalescedRun&&) noexcept = default;
+    CoalescedRun& operator=(CoalescedRun&&) = delete;
+
+    ~CoalescedRun() {
+        if (m_entry) {
+            m_coalescer->take(*m_entry);
+        }
+    }
+
+    void operator()() {
+        unique_task task = m_coalescer->take(*std::exchange(m_entry, nullptr));
+        task();
+    }
+
+private:
+    TaskCoalescer* m_coalescer;
+    std::shared_ptr<TaskCoalescer::Entry> m_entry;
+};
+
+} // namespace util
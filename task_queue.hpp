@@ -0,0 +1,351 @@
+// task_queue.hpp
+#pragma once
+
+#include "cache_line.hpp"
+#include <algorithm>   // For std::push_heap and std::pop_heap
+#include <atomic>
+#include <bit>         // For std::bit_ceil
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>  // For std::greater
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Number of slots in the lock-free ring; rounded up to a power of two.
+#ifndef FNGO_RING_CAPACITY
+#define FNGO_RING_CAPACITY 4096
+#endif
+
+namespace util {
+
+/**
+ * @brief Requirements for a ThreadPool injection queue backend.
+ *
+ * try_push must leave the item untouched when it returns false, so the caller can
+ * retry with the same object. try_push_bulk moves a prefix of the items in and
+ * returns its length; the rest are left untouched. size() may be approximate
+ * but must be lock-free, because idle workers use it to decide whether to go to sleep.
+ */
+template<typename Q, typename T>
+concept TaskQueuePolicy = requires(Q& queue, const Q& const_queue, T&& item, T& out, std::span<T> items) {
+    { queue.try_push(std::move(item)) } -> std::same_as<bool>;
+    { queue.try_push_bulk(items) } -> std::same_as<std::size_t>;
+    { queue.try_pop(out) } -> std::same_as<bool>;
+    { const_queue.size() } -> std::convertible_to<std::size_t>;
+};
+
+
+/**
+ * @class LockedTaskQueue
+ * @brief An unbounded FIFO guarded by a mutex. The default backend.
+ *
+ * Items live in a growable circular buffer rather than a std::deque, so once the
+ * queue has reached its working size pushes and pops no longer allocate.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename T>
+class LockedTaskQueue {
+public:
+    bool try_push(T&& item) {
+        std::scoped_lock lock(m_mutex);
+        if (m_count == m_slots.size()) {
+            grow();
+        }
+        m_slots[(m_head + m_count) & (m_slots.size() - 1)] = std::move(item);
+        m_size.store(++m_count, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Takes the lock once for the whole batch.
+    std::size_t try_push_bulk(std::span<T> items) {
+        std::scoped_lock lock(m_mutex);
+        while (m_slots.size() - m_count < items.size()) {
+            grow();
+        }
+        for (T& item : items) {
+            m_slots[(m_head + m_count++) & (m_slots.size() - 1)] = std::move(item);
+        }
+        m_size.store(m_count, std::memory_order_relaxed);
+        return items.size();
+    }
+
+    bool try_pop(T& out) {
+        if (m_size.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        std::scoped_lock lock(m_mutex);
+        if (m_count == 0) {
+            return false;
+        }
+        out = std::move(m_slots[m_head]);
+        m_slots[m_head] = T{};
+        m_head = (m_head + 1) & (m_slots.size() - 1);
+        m_size.store(--m_count, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::size_t size() const noexcept { return m_size.load(std::memory_order_relaxed); }
+
+private:
+    void grow() {
+        std::vector<T> bigger(m_slots.empty() ? 64 : m_slots.size() * 2);
+        for (std::size_t i = 0; i < m_count; ++i) {
+            bigger[i] = std::move(m_slots[(m_head + i) & (m_slots.size() - 1)]);
+        }
+        m_slots = std::move(bigger);
+        m_head = 0;
+    }
+
+    std::vector<T> m_slots; // Power-of-two sized ring.
+    std::size_t m_head = 0;
+    std::size_t m_count = 0;
+    std::atomic<std::size_t> m_size{0}; // Mirror of m_count readable without the lock.
+    std::mutex m_mutex;
+};
+
+
+/**
+ * @class MpmcRingQueue
+ * @brief A bounded, lock-free multi-producer/multi-consumer ring buffer.
+ *
+ * Dmitry Vyukov's algorithm: each cell carries a sequence number that tells
+ * producers and consumers whether the cell is free for the lap they are on, so a
+ * push or pop costs one CAS on the shared position plus one release store. The
+ * capacity is a power of two, and cells and positions are padded to cache lines
+ * so that producers and consumers do not false-share.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename T>
+class MpmcRingQueue {
+public:
+    explicit MpmcRingQueue(std::size_t capacity = FNGO_RING_CAPACITY)
+        : m_mask(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity) - 1),
+          m_cells(std::make_unique<Cell[]>(m_mask + 1)) {
+        for (std::size_t i = 0; i <= m_mask; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false, without moving from item, when the ring is full.
+    bool try_push(T&& item) {
+        Cell* cell;
+        std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // The cell still holds an item from the previous lap.
+            } else {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Claims a run of consecutive free cells with a single CAS. A cell that is
+    // free for this lap can only be taken by a producer that advances
+    // m_enqueue_pos past it, so checking the run first and then moving the
+    // position over it is safe.
+    std::size_t try_push_bulk(std::span<T> items) {
+        std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            std::size_t run = 0;
+            while (run < items.size() && m_cells[(pos + run) & m_mask].sequence.load(std::memory_order_acquire) == pos + run) {
+                ++run;
+            }
+            if (run == 0) {
+                const std::size_t seq = m_cells[pos & m_mask].sequence.load(std::memory_order_acquire);
+                if (static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos) < 0) {
+                    return 0; // Full.
+                }
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + run, std::memory_order_relaxed)) {
+                for (std::size_t i = 0; i < run; ++i) {
+                    Cell& cell = m_cells[(pos + i) & m_mask];
+                    cell.value = std::move(items[i]);
+                    cell.sequence.store(pos + i + 1, std::memory_order_release);
+                }
+                return run;
+            }
+        }
+    }
+
+    bool try_pop(T& out) {
+        Cell* cell;
+        std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // Empty.
+            } else {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->value = T{}; // Release whatever the task captured now, not on the next lap.
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t size() const noexcept {
+        const std::size_t tail = m_dequeue_pos.load(std::memory_order_relaxed);
+        const std::size_t head = m_enqueue_pos.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    std::size_t capacity() const noexcept { return m_mask + 1; }
+
+private:
+    struct alignas(cache_line_size) Cell {
+        std::atomic<std::size_t> sequence{0};
+        T value{};
+    };
+
+    const std::size_t m_mask;
+    const std::unique_ptr<Cell[]> m_cells;
+    alignas(cache_line_size) std::atomic<std::size_t> m_enqueue_pos{0};
+    alignas(cache_line_size) std::atomic<std::size_t> m_dequeue_pos{0};
+};
+
+
+/**
+ * @class DeadlineTaskQueue
+ * @brief A min-heap of items ordered by deadline, guarded by a mutex.
+ *
+ * try_pop returns the item with the earliest deadline; ties go to the lower
+ * rank, then to the item pushed first, so items without a real deadline
+ * (TimePoint::max()) come out in FIFO order after every item that has one.
+ * Push and pop are O(log n) under the lock.
+ *
+ * @note This class is an internal implementation detail.
+ */
+template<typename T, typename TimePoint>
+class DeadlineTaskQueue {
+public:
+    void push(T&& item, TimePoint deadline, unsigned rank) {
+        std::scoped_lock lock(m_mutex);
+        push_locked(std::move(item), deadline, rank);
+        m_size.store(m_heap.size(), std::memory_order_relaxed);
+    }
+
+    // Takes the lock once for the whole batch.
+    void push_bulk(std::span<T> items, TimePoint deadline, unsigned rank) {
+        std::scoped_lock lock(m_mutex);
+        m_heap.reserve(m_heap.size() + items.size());
+        for (T& item : items) {
+            push_locked(std::move(item), deadline, rank);
+        }
+        m_size.store(m_heap.size(), std::memory_order_relaxed);
+    }
+
+    bool try_pop(T& out, TimePoint& deadline) {
+        if (m_size.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        std::scoped_lock lock(m_mutex);
+        if (m_heap.empty()) {
+            return false;
+        }
+        std::ranges::pop_heap(m_heap, std::greater<>{});
+        out = std::move(m_heap.back().item);
+        deadline = m_heap.back().deadline;
+        m_heap.pop_back();
+        m_size.store(m_heap.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    // Removes the item whose deadline is furthest away among those `may_take`
+    // accepts. The latest item overall is a leaf of the heap, so the second
+    // half of the array is searched first; only if may_take refuses that one
+    // is the whole array searched.
+    template<typename Pred>
+    bool try_pop_latest(T& out, Pred may_take) {
+        std::scoped_lock lock(m_mutex);
+        if (m_heap.empty()) {
+            return false;
+        }
+        const auto leaves = std::span(m_heap).subspan(m_heap.size() / 2);
+        auto latest = static_cast<std::size_t>(std::ranges::max_element(leaves, std::less<>{}) - leaves.begin()) + m_heap.size() / 2;
+        if (!may_take(std::as_const(m_heap[latest].item))) {
+            latest = m_heap.size();
+            for (std::size_t i = 0; i < m_heap.size(); ++i) {
+                if ((latest == m_heap.size() || m_heap[latest] < m_heap[i]) && may_take(std::as_const(m_heap[i].item))) {
+                    latest = i;
+                }
+            }
+            if (latest == m_heap.size()) {
+                return false;
+            }
+        }
+        out = std::move(m_heap[latest].item);
+        if (latest + 1 != m_heap.size()) {
+            m_heap[latest] = std::move(m_heap.back());
+            if (latest >= m_heap.size() / 2) {
+                // Filled a leaf's hole with the last entry: let it rise to its place.
+                std::push_heap(m_heap.begin(), m_heap.begin() + static_cast<std::ptrdiff_t>(latest) + 1, std::greater<>{});
+                m_heap.pop_back();
+            } else {
+                m_heap.pop_back();
+                std::ranges::make_heap(m_heap, std::greater<>{});
+            }
+        } else {
+            m_heap.pop_back();
+        }
+        m_size.store(m_heap.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    std::size_t size() const noexcept { return m_size.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        TimePoint deadline;
+        unsigned rank;
+        std::uint64_t sequence;
+        T item;
+
+        friend auto operator<=>(const Entry& a, const Entry& b) {
+            if (auto order = a.deadline <=> b.deadline; order != 0) {
+                return order;
+            }
+            if (auto order = a.rank <=> b.rank; order != 0) {
+                return order;
+            }
+            return a.sequence <=> b.sequence;
+        }
+        friend bool operator==(const Entry& a, const Entry& b) { return a.sequence == b.sequence; }
+    };
+
+    void push_locked(T&& item, TimePoint deadline, unsigned rank) {
+        m_heap.push_back(Entry{deadline, rank, m_next_sequence++, std::move(item)});
+        std::ranges::push_heap(m_heap, std::greater<>{});
+    }
+
+    std::vector<Entry> m_heap; // Min-heap under std::greater.
+    std::uint64_t m_next_sequence = 0;
+    std::atomic<std::size_t> m_size{0}; // Mirror of m_heap.size() readable without the lock.
+    std::mutex m_mutex;
+};
+
+} // namespace util
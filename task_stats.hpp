@@ -0,0 +1,257 @@
+// task_stats.hpp
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>         // For std::bit_width
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>  // For std::hash
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+
+// Clock used to timestamp task enqueue, start and end.
+using TaskClock = std::chrono::steady_clock;
+
+// Hashes task names for unordered containers keyed by std::string that are
+// looked up by std::string_view (with std::equal_to<>), without a copy.
+struct TaskNameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const noexcept { return std::hash<std::string_view>{}(name); }
+};
+
+
+/**
+ * @class HistogramSnapshot
+ * @brief A point-in-time copy of a LatencyHistogram, safe to merge and query.
+ *
+ * Buckets are log-linear, as in HdrHistogram: every power-of-two range of
+ * nanoseconds is split into sub_buckets equal slices, so a reported value is
+ * within 1/sub_buckets (about 6%) of the true one over the whole range.
+ */
+class HistogramSnapshot {
+public:
+    static constexpr unsigned sub_bucket_bits = 4;
+    static constexpr uint64_t sub_buckets = uint64_t{1} << sub_bucket_bits;
+    static constexpr unsigned max_bits = 40; // Values are clamped to about 18 minutes.
+    static constexpr size_t bucket_count = sub_buckets + (max_bits - sub_bucket_bits) * sub_buckets;
+
+    static constexpr size_t bucket_of(uint64_t nanoseconds) noexcept {
+        const uint64_t value = std::min(nanoseconds, (uint64_t{1} << max_bits) - 1);
+        if (value < sub_buckets) {
+            return static_cast<size_t>(value);
+        }
+        const unsigned magnitude = static_cast<unsigned>(std::bit_width(value)) - 1;
+        const unsigned shift = magnitude - sub_bucket_bits;
+        return static_cast<size_t>(sub_buckets + shift * sub_buckets + ((value >> shift) - sub_buckets));
+    }
+
+    // The largest value that falls into bucket.
+    static constexpr uint64_t bucket_upper_bound(size_t bucket) noexcept {
+        if (bucket < sub_buckets) {
+            return bucket;
+        }
+        const uint64_t shift = (bucket - sub_buckets) / sub_buckets;
+        const uint64_t slice = (bucket - sub_buckets) % sub_buckets;
+        return ((sub_buckets + slice + 1) << shift) - 1;
+    }
+
+    HistogramSnapshot() : m_counts(bucket_count, 0) {}
+
+    uint64_t count() const noexcept { return m_count; }
+    std::chrono::nanoseconds max() const noexcept { return std::chrono::nanoseconds(m_max); }
+
+    std::chrono::nanoseconds mean() const noexcept {
+        return std::chrono::nanoseconds(m_count ? m_sum / m_count : 0);
+    }
+
+    // The value below which `percent` percent of the samples fall, e.g. percentile(99).
+    std::chrono::nanoseconds percentile(double percent) const noexcept {
+        if (m_count == 0) {
+            return {};
+        }
+        const auto wanted = std::max<uint64_t>(1, static_cast<uint64_t>(percent / 100.0 * static_cast<double>(m_count) + 0.5));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < m_counts.size(); ++bucket) {
+            seen += m_counts[bucket];
+            if (seen >= wanted) {
+                return std::chrono::nanoseconds(std::min(bucket_upper_bound(bucket), m_max));
+            }
+        }
+        return max();
+    }
+
+    void merge(const HistogramSnapshot& other) noexcept {
+        for (size_t bucket = 0; bucket < m_counts.size(); ++bucket) {
+            m_counts[bucket] += other.m_counts[bucket];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+private:
+    friend class LatencyHistogram;
+
+    std::vector<uint64_t> m_counts;
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_max = 0;
+};
+
+
+/**
+ * @class LatencyHistogram
+ * @brief A single-writer histogram of durations that any thread may read.
+ *
+ * Only the owning worker records, so counters are bumped with a plain relaxed
+ * load and store instead of a locked read-modify-write; readers take a
+ * snapshot() that may miss samples recorded concurrently.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class LatencyHistogram {
+public:
+    void record(TaskClock::duration duration) noexcept {
+        const auto nanoseconds = static_cast<uint64_t>(std::max<int64_t>(0,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+        bump(m_counts[HistogramSnapshot::bucket_of(nanoseconds)], 1);
+        bump(m_count, 1);
+        bump(m_sum, nanoseconds);
+        if (nanoseconds > m_max.load(std::memory_order_relaxed)) {
+            m_max.store(nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    void snapshot_into(HistogramSnapshot& out) const noexcept {
+        for (size_t bucket = 0; bucket < m_counts.size(); ++bucket) {
+            out.m_counts[bucket] += m_counts[bucket].load(std::memory_order_relaxed);
+        }
+        out.m_count += m_count.load(std::memory_order_relaxed);
+        out.m_sum += m_sum.load(std::memory_order_relaxed);
+        out.m_max = std::max(out.m_max, m_max.load(std::memory_order_relaxed));
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t amount) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::bucket_count> m_counts{};
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_sum{0};
+    std::atomic<uint64_t> m_max{0};
+};
+
+
+/**
+ * @brief Latency of every run of the tasks sharing one name.
+ *
+ * queue_wait is the time from enqueue to the start of the run; run_time is the
+ * time the task body took. A large queue_wait with a small run_time points at
+ * a saturated pool, the opposite at a slow task.
+ */
+struct TaskLatency {
+    std::string name;
+    HistogramSnapshot queue_wait;
+    HistogramSnapshot run_time;
+
+    void merge(const TaskLatency& other) noexcept {
+        queue_wait.merge(other.queue_wait);
+        run_time.merge(other.run_time);
+    }
+};
+
+// Merges `from` into `into`, matching entries by name; keeps `into` sorted by name.
+inline void merge_latencies(std::vector<TaskLatency>& into, const std::vector<TaskLatency>& from) {
+    for (const TaskLatency& entry : from) {
+        auto position = std::ranges::lower_bound(into, entry.name, {}, &TaskLatency::name);
+        if (position == into.end() || position->name != entry.name) {
+            position = into.insert(position, TaskLatency{entry.name, {}, {}});
+        }
+        position->merge(entry);
+    }
+}
+
+
+/**
+ * @class TaskStatsTable
+ * @brief Per-name latency histograms owned by one writer thread.
+ *
+ * A fixed open-addressing table of lazily allocated entries. The owner inserts
+ * by publishing an entry pointer with a release store, so readers walk the
+ * table without a lock. Names beyond the table's capacity share one entry.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class TaskStatsTable {
+public:
+    static constexpr size_t capacity = 256;
+    static constexpr std::string_view overflow_name = "(other)";
+
+    TaskStatsTable() = default;
+    TaskStatsTable(const TaskStatsTable&) = delete;
+    TaskStatsTable& operator=(const TaskStatsTable&) = delete;
+
+    ~TaskStatsTable() {
+        for (auto& slot : m_slots) {
+            delete slot.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Owner only.
+    void record(std::string_view name, TaskClock::duration queue_wait, TaskClock::duration run_time) {
+        Entry& entry = find_or_add(name);
+        entry.queue_wait.record(queue_wait);
+        entry.run_time.record(run_time);
+    }
+
+    // Any thread. Appends this table's entries to out, unsorted and unmerged.
+    void snapshot_into(std::vector<TaskLatency>& out) const {
+        for (const auto& slot : m_slots) {
+            if (const Entry* entry = slot.load(std::memory_order_acquire)) {
+                TaskLatency& copy = out.emplace_back(TaskLatency{entry->name, {}, {}});
+                entry->queue_wait.snapshot_into(copy.queue_wait);
+                entry->run_time.snapshot_into(copy.run_time);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        LatencyHistogram queue_wait;
+        LatencyHistogram run_time;
+    };
+
+    Entry& find_or_add(std::string_view name) {
+        size_t slot = std::hash<std::string_view>{}(name) & (capacity - 1);
+        for (size_t probes = 0; probes < capacity; ++probes, slot = (slot + 1) & (capacity - 1)) {
+            Entry* entry = m_slots[slot].load(std::memory_order_relaxed);
+            if (entry && entry->name == name) {
+                return *entry;
+            }
+            if (!entry) {
+                // Keep the last free slot for the overflow entry.
+                if (m_used == capacity - 1 && name != overflow_name) {
+                    break;
+                }
+                entry = new Entry{std::string(name), {}, {}};
+                m_slots[slot].store(entry, std::memory_order_release);
+                ++m_used;
+                return *entry;
+            }
+        }
+        return find_or_add(overflow_name);
+    }
+
+    std::array<std::atomic<Entry*>, capacity> m_slots{};
+    size_t m_used = 0;
+};
+
+} // namespace util
@@ -0,0 +1,425 @@
+// tests.cpp
+// Unit tests for the pool's building blocks. Build and run with: make test
+//
+//   deque      Chase-Lev deque: LIFO pops, FIFO steals, growth, and every item
+//              taken exactly once while thieves race the owner
+//   mpmc       lock-free ring: FIFO order, full and empty edges, bulk claims of
+//              a partial run, and concurrent bulk producers
+//   timers     timer wheel: timers cascading down from level 1 fire in due
+//              order and never early; cancel, periodic timers and clear()
+//   coalesce   merging into a queued task, KeepFirst and KeepLast, and no
+//              merging into a task the pool has not accepted (yet)
+//   gcra       rate limiter: burst, ordered reservations and refill; the
+//              Delay, Reject and Coalesce policies on a pool
+
+#include "fire_n_go.hpp"
+#include "rate_limiter.hpp"
+#include "task_coalescer.hpp"
+#include "task_queue.hpp"
+#include "timer_wheel.hpp"
+#include "work_stealing_deque.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <source_location>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+// Reports a failed expectation and carries on with the rest of the test.
+void check(bool ok, const char* expression, std::source_location where = std::source_location::current()) {
+    if (!ok) {
+        std::fprintf(stderr, "%s:%u: check failed: %s\n", where.file_name(), static_cast<unsigned>(where.line()), expression);
+        ++failures;
+    }
+}
+
+#define CHECK(...) check(static_cast<bool>(__VA_ARGS__), #__VA_ARGS__)
+
+void deque_single_thread() {
+    util::WorkStealingDeque<int> deque(4);
+    CHECK(deque.empty());
+    CHECK(!deque.pop());
+    CHECK(!deque.steal());
+
+    // Past the initial capacity, so the buffer grows twice.
+    for (int i = 1; i <= 16; ++i) {
+        deque.push(i);
+    }
+    CHECK(deque.size() == 16);
+    CHECK(deque.steal() == 1); // Thieves take the oldest item...
+    CHECK(deque.steal() == 2);
+    CHECK(deque.pop() == 16); // ...the owner the newest.
+    CHECK(deque.pop() == 15);
+    CHECK(deque.size() == 12);
+
+    int expected = 14;
+    while (auto item = deque.pop()) {
+        CHECK(*item == expected--);
+    }
+    CHECK(expected == 2);
+    CHECK(deque.empty());
+    CHECK(!deque.steal());
+
+    // Still usable once drained.
+    deque.push(7);
+    CHECK(deque.steal() == 7);
+    CHECK(!deque.pop());
+}
+
+void deque_concurrent_steals() {
+    constexpr int items = 200'000;
+    constexpr int thieves = 3;
+    util::WorkStealingDeque<int> deque(2);
+    std::vector<std::atomic<int>> taken(items + 1);
+    std::atomic<bool> done{false};
+
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < thieves; ++i) {
+        threads.emplace_back([&] {
+            while (!done.load(std::memory_order_acquire) || !deque.empty()) {
+                if (auto item = deque.steal()) {
+                    taken[static_cast<size_t>(*item)].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    // The owner pops every third push, so pops and steals race for the last item.
+    for (int i = 1; i <= items; ++i) {
+        deque.push(i);
+        if (i % 3 == 0) {
+            if (auto item = deque.pop()) {
+                taken[static_cast<size_t>(*item)].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    while (auto item = deque.pop()) {
+        taken[static_cast<size_t>(*item)].fetch_add(1, std::memory_order_relaxed);
+    }
+    done.store(true, std::memory_order_release);
+    threads.clear();
+
+    int wrong = 0;
+    for (int i = 1; i <= items; ++i) {
+        wrong += taken[static_cast<size_t>(i)].load(std::memory_order_relaxed) != 1 ? 1 : 0;
+    }
+    CHECK(wrong == 0);
+}
+
+void mpmc_edges() {
+    util::MpmcRingQueue<std::unique_ptr<int>> ring(8);
+    std::unique_ptr<int> out;
+    CHECK(!ring.try_pop(out));
+
+    for (int i = 0; i < 8; ++i) {
+        CHECK(ring.try_push(std::make_unique<int>(i)));
+    }
+    auto rejected = std::make_unique<int>(8);
+    CHECK(!ring.try_push(std::move(rejected)));
+    CHECK(rejected && *rejected == 8); // Left untouched for a retry.
+    CHECK(ring.size() == 8);
+
+    // Frees three cells at the front; a bulk push of five claims exactly those.
+    for (int i = 0; i < 3; ++i) {
+        CHECK(ring.try_pop(out) && *out == i);
+    }
+    std::array<std::unique_ptr<int>, 5> batch;
+    for (int i = 0; i < 5; ++i) {
+        batch[static_cast<size_t>(i)] = std::make_unique<int>(8 + i);
+    }
+    CHECK(ring.try_push_bulk(batch) == 3);
+    CHECK(!batch[0] && !batch[2] && batch[3] && *batch[3] == 11); // The rest stay with the caller.
+    CHECK(ring.try_push_bulk(std::span(batch).subspan(3)) == 0);
+
+    // Order holds across single and bulk pushes and the wrap-around.
+    for (int i = 3; i < 11; ++i) {
+        CHECK(ring.try_pop(out) && *out == i);
+    }
+    CHECK(!ring.try_pop(out));
+    CHECK(ring.size() == 0);
+    CHECK(ring.try_push_bulk(std::span(batch).subspan(3)) == 2);
+    CHECK(ring.try_pop(out) && *out == 11);
+    CHECK(ring.try_pop(out) && *out == 12);
+}
+
+void mpmc_concurrent_bulk() {
+    constexpr int producers = 4;
+    constexpr int consumers = 4;
+    constexpr int per_producer = 50'000;
+    constexpr int batch_size = 5;
+    util::MpmcRingQueue<int> ring(64);
+    std::vector<std::atomic<int>> taken(producers * per_producer);
+    std::atomic<int> remaining{producers * per_producer};
+    std::atomic<int> out_of_order{0};
+
+    std::vector<std::jthread> threads;
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&] {
+            // Cells are claimed in order, so one consumer sees each producer's items in order.
+            std::array<int, producers> last;
+            last.fill(-1);
+            while (remaining.load(std::memory_order_relaxed) > 0) {
+                int item;
+                if (!ring.try_pop(item)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                const int producer = item / per_producer;
+                out_of_order.fetch_add(item <= last[static_cast<size_t>(producer)] ? 1 : 0, std::memory_order_relaxed);
+                last[static_cast<size_t>(producer)] = item;
+                taken[static_cast<size_t>(item)].fetch_add(1, std::memory_order_relaxed);
+                remaining.fetch_sub(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&ring, p] {
+            for (int first = p * per_producer; first < (p + 1) * per_producer; first += batch_size) {
+                std::array<int, batch_size> batch;
+                for (int i = 0; i < batch_size; ++i) {
+                    batch[static_cast<size_t>(i)] = first + i;
+                }
+                for (size_t pushed = 0; pushed < batch.size();) {
+                    const size_t claimed = ring.try_push_bulk(std::span(batch).subspan(pushed));
+                    pushed += claimed;
+                    if (claimed == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        });
+    }
+    threads.clear();
+
+    int wrong = 0;
+    for (const auto& count : taken) {
+        wrong += count.load(std::memory_order_relaxed) != 1 ? 1 : 0;
+    }
+    CHECK(wrong == 0);
+    CHECK(out_of_order.load() == 0);
+}
+
+void timers_cascade() {
+    using namespace std::chrono_literals;
+    using Clock = util::TimerWheel::Clock;
+    // Level 0 spans 64 ticks of 1 ms; later timers start on level 1 and cascade down.
+    constexpr std::array<std::chrono::milliseconds, 8> delays{150ms, 1ms, 64ms, 65ms, 63ms, 129ms, 0ms, 200ms};
+    util::TimerWheel wheel;
+    std::mutex mutex;
+    std::vector<std::pair<size_t, Clock::duration>> fired; // Timer index, time from add to firing.
+
+    const Clock::time_point added = Clock::now();
+    for (size_t i = 0; i < delays.size(); ++i) {
+        wheel.add(delays[i], Clock::duration::zero(), [&, i] {
+            const std::scoped_lock lock(mutex);
+            fired.emplace_back(i, Clock::now() - added);
+        });
+    }
+    const auto cancelled = wheel.add(100ms, Clock::duration::zero(), [&] {
+        const std::scoped_lock lock(mutex);
+        fired.emplace_back(delays.size(), Clock::now() - added);
+    });
+    CHECK(wheel.cancel(cancelled));
+    CHECK(!wheel.cancel(cancelled)); // Its Id is stale now.
+
+    std::jthread timer_thread([&wheel](std::stop_token stoken) { wheel.run(std::move(stoken)); });
+    std::this_thread::sleep_for(400ms);
+    timer_thread = {};
+
+    const std::scoped_lock lock(mutex);
+    CHECK(fired.size() == delays.size());
+    for (size_t i = 0; i < fired.size(); ++i) {
+        const auto [timer, elapsed] = fired[i];
+        CHECK(timer < delays.size());
+        if (timer >= delays.size()) {
+            continue;
+        }
+        CHECK(elapsed >= delays[timer]);
+        if (i > 0 && fired[i - 1].first < delays.size()) {
+            CHECK(delays[fired[i - 1].first] <= delays[timer]);
+        }
+    }
+}
+
+void timers_periodic_and_clear() {
+    using namespace std::chrono_literals;
+    util::TimerWheel wheel;
+    std::atomic<int> ticks{0};
+    wheel.add(10ms, 10ms, [&ticks] { ticks.fetch_add(1, std::memory_order_relaxed); });
+    std::jthread timer_thread([&wheel](std::stop_token stoken) { wheel.run(std::move(stoken)); });
+    std::this_thread::sleep_for(105ms);
+    timer_thread = {};
+    const int seen = ticks.load(std::memory_order_relaxed);
+    CHECK(seen >= 5 && seen <= 10);
+
+    // Only timers that carry a task are counted; the periodic one does not.
+    wheel.add(1h, util::TimerWheel::Clock::duration::zero(), [] {}, true);
+    wheel.add(2h, 1h, [] {}, true);
+    wheel.add(5h, util::TimerWheel::Clock::duration::zero(), [] {}); // Beyond the wheel: the overflow list.
+    CHECK(wheel.clear() == 2);
+    CHECK(wheel.clear() == 0);
+}
+
+void coalescer_publication() {
+    util::TaskCoalescer coalescer;
+    int ran = 0;
+    util::unique_task first([&ran] { ran = 1; });
+    const auto entry = coalescer.add("refresh", first, util::Coalesce::KeepLast);
+    CHECK(entry != nullptr);
+
+    // Not yet accepted by the pool: a second submission must not merge into it.
+    util::unique_task second([&ran] { ran = 2; });
+    const auto detached = coalescer.add("refresh", second, util::Coalesce::KeepLast);
+    CHECK(detached != nullptr && detached != entry);
+    coalescer.take(*detached); // Leaves the first entry alone.
+    CHECK(coalescer.merged_count() == 0);
+
+    coalescer.publish(*entry);
+    util::unique_task third([&ran] { ran = 3; });
+    CHECK(coalescer.add("refresh", third, util::Coalesce::KeepLast) == nullptr);
+    third(); // KeepLast hands back the callable it replaced.
+    CHECK(ran == 1);
+    util::unique_task fourth([&ran] { ran = 4; });
+    CHECK(coalescer.add("refresh", fourth, util::Coalesce::KeepFirst) == nullptr);
+    CHECK(fourth); // KeepFirst leaves the new one to be destroyed.
+    CHECK(coalescer.merged_count() == 2);
+
+    coalescer.take(*entry)();
+    CHECK(ran == 3);
+    util::unique_task fifth([] {});
+    const auto next = coalescer.add("refresh", fifth, util::Coalesce::KeepLast);
+    CHECK(next != nullptr); // The entry is gone once taken.
+    coalescer.take(*next);
+}
+
+void coalescer_in_pool() {
+    util::ThreadPool pool({.name = "coalesce", .threads = 1, .max_queued_tasks = 2, .overflow = util::OverflowPolicy::FailFast});
+    std::latch release(1);
+    std::atomic<int> ran{0};
+    std::atomic<int> last{0};
+    util::fire_and_forget(pool, "blocker", [&release] { release.wait(); });
+    while (pool.try_enqueue([] {})) {
+        // Fills the queue; the blocker may not have started yet, so keep going until it is full.
+    }
+    // Rejected while the queue is full: the entry is removed, so nothing merges into lost work.
+    CHECK(!util::try_fire_and_forget(pool, "refresh", [&ran] { ran.fetch_add(1); }, {.coalesce = util::Coalesce::KeepLast}));
+    CHECK(!util::try_fire_and_forget(pool, "refresh", [&ran] { ran.fetch_add(1); }, {.coalesce = util::Coalesce::KeepLast}));
+    CHECK(pool.coalesced_count() == 0);
+    release.count_down();
+    std::latch drained(1);
+    while (!pool.try_enqueue([&drained] { drained.count_down(); })) {
+        std::this_thread::yield();
+    }
+    drained.wait(); // One worker: everything queued before has run.
+
+    // Accepted and published: later submissions merge into it while it waits behind the blocker.
+    std::latch release_again(1);
+    util::fire_and_forget(pool, "blocker", [&release_again] { release_again.wait(); });
+    for (int i = 1; i <= 5; ++i) {
+        CHECK(util::try_fire_and_forget(pool, "refresh", [&ran, &last, i] { ran.fetch_add(1); last = i; },
+                                        {.coalesce = util::Coalesce::KeepLast}));
+    }
+    release_again.count_down();
+    pool.shutdown();
+    CHECK(ran.load() == 1);
+    CHECK(last.load() == 5);
+    CHECK(pool.coalesced_count() == 4);
+}
+
+void gcra_tokens() {
+    using namespace std::chrono_literals;
+    util::RateLimiter limiter({.task_name = "query", .per_second = 10, .burst = 3});
+    const util::TaskClock::time_point now(1h);
+    for (int i = 0; i < 3; ++i) {
+        CHECK(limiter.acquire(now, false) == now); // The full bucket allows a burst.
+    }
+    CHECK(!limiter.acquire(now, false));
+    // Waiting tasks reserve consecutive slots, one interval apart.
+    CHECK(limiter.acquire(now, true) == now + 100ms);
+    CHECK(limiter.acquire(now, true) == now + 200ms);
+    // Idle for long enough, the bucket is full again, but no fuller.
+    const auto later = now + 1s;
+    for (int i = 0; i < 3; ++i) {
+        CHECK(limiter.acquire(later, false) == later);
+    }
+    CHECK(!limiter.acquire(later, false));
+}
+
+void gcra_policies() {
+    using namespace std::chrono_literals;
+    util::ThreadPool pool({.name = "limited", .threads = 2,
+                           .rate_limits = {{.task_name = "reject", .per_second = 1, .burst = 2, .policy = util::RateLimitPolicy::Reject},
+                                           {.task_name = "delay", .per_second = 20, .burst = 1, .policy = util::RateLimitPolicy::Delay},
+                                           {.task_name = "coalesce", .per_second = 10, .burst = 1, .policy = util::RateLimitPolicy::Coalesce}}});
+
+    std::atomic<int> rejected_ran{0};
+    CHECK(util::try_fire_and_forget(pool, "reject", [&rejected_ran] { rejected_ran.fetch_add(1); }));
+    CHECK(util::try_fire_and_forget(pool, "reject", [&rejected_ran] { rejected_ran.fetch_add(1); }));
+    CHECK(!util::try_fire_and_forget(pool, "reject", [&rejected_ran] { rejected_ran.fetch_add(1); }));
+
+    const auto submitted = util::TaskClock::now();
+    std::mutex mutex;
+    std::vector<std::pair<int, util::TaskClock::duration>> delayed; // Submission index, time to start.
+    for (int i = 0; i < 3; ++i) {
+        CHECK(util::try_fire_and_forget(pool, "delay", [&, i] {
+            const std::scoped_lock lock(mutex);
+            delayed.emplace_back(i, util::TaskClock::now() - submitted);
+        }));
+    }
+
+    std::atomic<int> coalesced_ran{0};
+    std::atomic<int> last{0};
+    for (int i = 1; i <= 5; ++i) {
+        CHECK(util::try_fire_and_forget(pool, "coalesce", [&coalesced_ran, &last, i] { coalesced_ran.fetch_add(1); last = i; }));
+    }
+
+    std::this_thread::sleep_for(300ms);
+    pool.shutdown();
+    CHECK(rejected_ran.load() == 2);
+
+    CHECK(delayed.size() == 3);
+    for (size_t i = 0; i < delayed.size(); ++i) {
+        CHECK(delayed[i].first == static_cast<int>(i)); // Held tasks start in submission order...
+        CHECK(delayed[i].second >= static_cast<int>(i) * 50ms); // ...each one interval after the last.
+    }
+
+    // The first run may have started before the rest arrived; everything after it merges into one.
+    CHECK(coalesced_ran.load() >= 1 && coalesced_ran.load() <= 2);
+    CHECK(coalesced_ran.load() + static_cast<int>(pool.coalesced_count()) == 5);
+    CHECK(last.load() == 5);
+}
+
+} // namespace
+
+int main() {
+    const struct {
+        const char* name;
+        void (*run)();
+    } tests[] = {
+        {"deque single thread", deque_single_thread},
+        {"deque concurrent steals", deque_concurrent_steals},
+        {"mpmc full and empty edges", mpmc_edges},
+        {"mpmc concurrent bulk producers", mpmc_concurrent_bulk},
+        {"timers cascade in due order", timers_cascade},
+        {"timers periodic and clear", timers_periodic_and_clear},
+        {"coalescer publication", coalescer_publication},
+        {"coalescer in a bounded pool", coalescer_in_pool},
+        {"gcra tokens", gcra_tokens},
+        {"gcra pool policies", gcra_policies},
+    };
+    for (const auto& test : tests) {
+        const int failures_before = failures;
+        test.run();
+        std::printf("%-40s %s\n", test.name, failures == failures_before ? "ok" : "FAILED");
+    }
+    std::printf("%d check(s) failed.\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,265 @@
+// timer_wheel.cpp
+#include "timer_wheel.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <bit>         // For std::bit_width and std::countr_zero
+#include <exception>
+#include <utility>
+
+namespace util {
+
+TimerWheel::TimerWheel() : m_origin(Clock::now()) {
+    m_heads.fill(npos);
+}
+
+TimerWheel::Tick TimerWheel::tick_at(Clock::time_point time) const noexcept {
+    return time <= m_origin ? 0 : static_cast<Tick>(std::chrono::floor<Resolution>(time - m_origin).count());
+}
+
+TimerWheel::Tick TimerWheel::ticks_in(Clock::duration duration) const noexcept {
+    return duration <= Clock::duration::zero() ? 0 : static_cast<Tick>(std::chrono::ceil<Resolution>(duration).count());
+}
+
+TimerWheel::Clock::time_point TimerWheel::time_of(Tick tick) const noexcept {
+    return m_origin + resolution * tick;
+}
+
+TimerWheel::Id TimerWheel::add(Clock::duration delay, Clock::duration period, unique_task trigger, bool carries_task) {
+    // Rounded up, so a timer never fires early.
+    const Tick due = ticks_in(Clock::now() + std::max(delay, Clock::duration::zero()) - m_origin);
+
+    std::unique_lock lock(m_mutex);
+    uint32_t index = m_free;
+    if (index != npos) {
+        m_free = m_nodes[index].next;
+    } else {
+        index = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    Node& node = m_nodes[index];
+    node.due = std::max(due, m_current + 1); // The current tick has already been processed.
+    node.carries_task = carries_task;
+    if (period > Clock::duration::zero()) {
+        node.period = std::max<Tick>(1, ticks_in(period));
+        node.repeat = std::make_shared<unique_task>(std::move(trigger));
+    } else {
+        node.period = 0;
+        node.once = std::move(trigger);
+    }
+    insert(index);
+
+    const Id id{index, node.generation};
+    if (node.due < m_sleep_until) {
+        m_sleep_until = node.due;
+        lock.unlock();
+        m_wakeup.notify_one();
+    }
+    return id;
+}
+
+bool TimerWheel::cancel(Id id) {
+    // Declared before the lock, so the triggers are destroyed after it is released.
+    unique_task once;
+    std::shared_ptr<unique_task> repeat;
+
+    const std::scoped_lock lock(m_mutex);
+    if (id.index >= m_nodes.size()) {
+        return false;
+    }
+    Node& node = m_nodes[id.index];
+    if (node.generation != id.generation || node.list == npos) {
+        return false;
+    }
+    unlink(id.index);
+    once = std::move(node.once);
+    repeat = std::move(node.repeat);
+    release(id.index);
+    return true;
+}
+
+size_t TimerWheel::clear() {
+    // Declared before the lock, so the triggers are destroyed after it is released.
+    std::vector<unique_task> once;
+    std::vector<std::shared_ptr<unique_task>> repeat;
+
+    size_t tasks = 0;
+    const std::scoped_lock lock(m_mutex);
+    for (uint32_t list = 0; list <= overflow_list; ++list) {
+        while (m_heads[list] != npos) {
+            const uint32_t index = m_heads[list];
+            unlink(index);
+            Node& node = m_nodes[index];
+            tasks += node.carries_task ? 1 : 0;
+            if (node.period != 0) {
+                repeat.push_back(std::move(node.repeat));
+            } else {
+                once.push_back(std::move(node.once));
+            }
+            release(index);
+        }
+    }
+    return tasks;
+}
+
+// Links a node into the slot for its due tick, relative to m_current: the
+// level is that of the highest 6-bit group in which the two differ.
+void TimerWheel::insert(uint32_t index) {
+    Node& node = m_nodes[index];
+    const Tick differing = node.due ^ m_current;
+    uint32_t list = overflow_list;
+    if ((differing >> (slot_bits * levels)) == 0) {
+        const unsigned level = differing == 0 ? 0 : static_cast<unsigned>(std::bit_width(differing) - 1) / slot_bits;
+        const auto slot = static_cast<uint32_t>((node.due >> (level * slot_bits)) & (slots_per_level - 1));
+        list = static_cast<uint32_t>(level * slots_per_level) + slot;
+        m_occupied[level] |= uint64_t{1} << slot;
+    }
+    node.prev = npos;
+    node.next = m_heads[list];
+    if (node.next != npos) {
+        m_nodes[node.next].prev = index;
+    }
+    m_heads[list] = index;
+    node.list = list;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& node = m_nodes[index];
+    if (node.prev != npos) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_heads[node.list] = node.next;
+    }
+    if (node.next != npos) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    if (m_heads[node.list] == npos && node.list != overflow_list) {
+        m_occupied[node.list / slots_per_level] &= ~(uint64_t{1} << (node.list % slots_per_level));
+    }
+    node.list = npos;
+}
+
+// Returns an unlinked node, whose triggers have been moved out, to the free list.
+void TimerWheel::release(uint32_t index) {
+    Node& node = m_nodes[index];
+    ++node.generation; // Invalidates outstanding Ids.
+    node.next = m_free;
+    m_free = index;
+}
+
+// Moves every node of a slot that the wheel has reached down to where it now belongs.
+void TimerWheel::cascade(uint32_t list) {
+    uint32_t index = std::exchange(m_heads[list], npos);
+    if (list != overflow_list) {
+        m_occupied[list / slots_per_level] &= ~(uint64_t{1} << (list % slots_per_level));
+    }
+    while (index != npos) {
+        const uint32_t next = m_nodes[index].next;
+        insert(index);
+        index = next;
+    }
+}
+
+// The next tick at which a level-0 slot comes due or a higher slot must cascade.
+TimerWheel::Tick TimerWheel::next_event() const noexcept {
+    Tick next = no_tick;
+    for (size_t level = 0; level < levels; ++level) {
+        const unsigned shift = static_cast<unsigned>(level) * slot_bits;
+        const auto current_slot = static_cast<unsigned>((m_current >> shift) & (slots_per_level - 1));
+        // Slots at or before the current one were emptied when the wheel passed them.
+        const uint64_t ahead = current_slot + 1 == slots_per_level ? 0 : m_occupied[level] & (~uint64_t{0} << (current_slot + 1));
+        if (ahead != 0) {
+            const Tick rotation = (m_current >> (shift + slot_bits)) << (shift + slot_bits);
+            next = std::min(next, rotation + (Tick{static_cast<unsigned>(std::countr_zero(ahead))} << shift));
+        }
+    }
+    if (m_heads[overflow_list] != npos) {
+        constexpr unsigned span_bits = slot_bits * levels;
+        next = std::min(next, ((m_current >> span_bits) + 1) << span_bits);
+    }
+    return next;
+}
+
+void TimerWheel::advance(Tick target, std::vector<unique_task>& once, std::vector<std::shared_ptr<unique_task>>& repeat) {
+    for (Tick tick = next_event(); tick <= target; tick = next_event()) {
+        m_current = tick;
+        // Highest level first, so that nodes can fall through several levels at once.
+        if ((tick & ((Tick{1} << (slot_bits * levels)) - 1)) == 0) {
+            cascade(overflow_list);
+        }
+        for (size_t level = levels - 1; level > 0; --level) {
+            const unsigned shift = static_cast<unsigned>(level) * slot_bits;
+            if ((tick & ((Tick{1} << shift) - 1)) == 0) {
+                cascade(static_cast<uint32_t>(level * slots_per_level + ((tick >> shift) & (slots_per_level - 1))));
+            }
+        }
+
+        const auto slot = static_cast<uint32_t>(tick & (slots_per_level - 1));
+        uint32_t index = std::exchange(m_heads[slot], npos);
+        m_occupied[0] &= ~(uint64_t{1} << slot);
+        while (index != npos) {
+            Node& node = m_nodes[index];
+            const uint32_t next = node.next;
+            node.list = npos;
+            if (node.period != 0) {
+                repeat.push_back(node.repeat);
+                // Skip the periods a late wake-up missed rather than firing them in a burst.
+                node.due += node.period;
+                if (node.due <= target) {
+                    node.due += ((target - node.due) / node.period + 1) * node.period;
+                }
+                insert(index);
+            } else {
+                once.push_back(std::move(node.once));
+                release(index);
+            }
+            index = next;
+        }
+    }
+    m_current = std::max(m_current, target);
+}
+
+void TimerWheel::fire(unique_task& trigger) noexcept {
+    try {
+        trigger();
+    } catch (const std::exception& e) {
+        const char* error_what = e.what();
+        log::print<log::Level::Error>("Timer", "Failed to hand a due timer to the pool: {}", error_what);
+    } catch (...) {
+        log::print<log::Level::Error>("Timer", "Failed to hand a due timer to the pool: unknown exception.");
+    }
+}
+
+void TimerWheel::run(std::stop_token stoken) {
+    std::vector<unique_task> once;
+    std::vector<std::shared_ptr<unique_task>> repeat;
+    std::unique_lock lock(m_mutex);
+    while (!stoken.stop_requested()) {
+        advance(tick_at(Clock::now()), once, repeat);
+        if (!once.empty() || !repeat.empty()) {
+            m_sleep_until = 0; // Awake: add() need not notify.
+            lock.unlock();
+            // One trigger failing must not cost the ones after it their run.
+            for (unique_task& trigger : once) {
+                fire(trigger);
+            }
+            for (const auto& trigger : repeat) {
+                fire(*trigger);
+            }
+            once.clear();
+            repeat.clear();
+            lock.lock();
+            continue;
+        }
+
+        const Tick next = next_event();
+        m_sleep_until = next;
+        const auto rescheduled = [this, next] { return m_sleep_until != next; };
+        if (next == no_tick) {
+            m_wakeup.wait(lock, stoken, rescheduled);
+        } else {
+            m_wakeup.wait_until(lock, stoken, time_of(next), rescheduled);
+        }
+    }
+}
+
+} // namespace util
@@ -0,0 +1,134 @@
+// timer_wheel.hpp
+#pragma once
+
+#include "unique_task.hpp"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <vector>
+
+namespace util {
+
+/**
+ * @class TimerWheel
+ * @brief Pending timers of one ThreadPool, kept in a hierarchical timing wheel.
+ *
+ * Time advances in ticks of `resolution`. Level 0 has one slot per tick for
+ * the next 64 ticks, level 1 one slot per 64 ticks for the next 64^2, and so
+ * on for four levels (about 4.6 hours); timers further out wait in an
+ * overflow list. Slots are intrusive lists of slab-allocated nodes, so adding
+ * and cancelling a timer are O(1) and allocate only when the slab grows. A
+ * timer drops one level whenever the wheel reaches the slot it sits in, and a
+ * 64-bit occupancy mask per level lets the wheel skip straight to the next
+ * slot that holds anything instead of visiting every tick.
+ *
+ * A due timer's trigger is called on the timer thread, outside the lock; it
+ * is expected to do nothing but hand work to the pool.
+ *
+ * @note This class is an internal implementation detail.
+ */
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Resolution = std::chrono::milliseconds;
+    static constexpr Resolution resolution{1};
+
+    // Names one scheduled timer; stale once the timer has fired or been cancelled.
+    struct Id {
+        uint32_t index = 0;
+        uint32_t generation = 0;
+    };
+
+    TimerWheel();
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Calls trigger once `delay` has passed and, with a non-zero period, every
+    // period after that. Periods are measured from the first due time, so a
+    // late tick does not shift the ones after it. carries_task marks a timer
+    // whose trigger queues work of its own, which clear() then counts. Any thread.
+    Id add(Clock::duration delay, Clock::duration period, unique_task trigger, bool carries_task = false);
+
+    // Returns true if the timer was pending; it will then not be triggered again,
+    // unless the timer thread has already picked it up. Any thread.
+    bool cancel(Id id);
+
+    // Drops every pending timer without triggering it and returns how many of
+    // them carried a task. Any thread.
+    size_t clear();
+
+    // Body of the timer thread: triggers due timers until stop is requested.
+    void run(std::stop_token stoken);
+
+private:
+    using Tick = uint64_t;
+    static constexpr uint32_t npos = UINT32_MAX;
+    static constexpr unsigned slot_bits = 6;
+    static constexpr size_t slots_per_level = size_t{1} << slot_bits;
+    static constexpr size_t levels = 4;
+    static constexpr size_t overflow_list = levels * slots_per_level; // Index of the overflow list head.
+    static constexpr Tick no_tick = UINT64_MAX;
+
+    struct Node {
+        Tick due = 0;
+        Tick period = 0; // In ticks; 0 for a one-shot timer.
+        uint32_t prev = npos;
+        uint32_t next = npos;
+        uint32_t list = npos; // Head this node is linked into, npos while free.
+        uint32_t generation = 0;
+        bool carries_task = false;
+        unique_task once;                    // One-shot trigger.
+        std::shared_ptr<unique_task> repeat; // Periodic trigger, shared with in-flight calls.
+    };
+
+    Tick tick_at(Clock::time_point time) const noexcept;
+    Tick ticks_in(Clock::duration duration) const noexcept;
+    Clock::time_point time_of(Tick tick) const noexcept;
+    void insert(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    void cascade(uint32_t list);
+    Tick next_event() const noexcept;
+    void advance(Tick target, std::vector<unique_task>& once, std::vector<std::shared_ptr<unique_task>>& repeat);
+    static void fire(unique_task& trigger) noexcept;
+
+    const Clock::time_point m_origin;
+    std::mutex m_mutex;
+    std::condition_variable_any m_wakeup;
+    Tick m_current = 0; // Last tick processed.
+    Tick m_sleep_until = no_tick; // When the timer thread plans to wake up next.
+    std::vector<Node> m_nodes;
+    uint32_t m_free = npos;
+    std::array<uint32_t, overflow_list + 1> m_heads;
+    std::array<uint64_t, levels> m_occupied{}; // Bit s set: slot s of that level is non-empty.
+};
+
+
+/**
+ * @class TimerHandle
+ * @brief Refers to a timer started with fire_after or fire_every.
+ *
+ * Dropping the handle does not cancel the timer. A handle may outlive its pool.
+ */
+class TimerHandle {
+public:
+    TimerHandle() = default;
+    TimerHandle(std::weak_ptr<TimerWheel> wheel, TimerWheel::Id id) noexcept : m_wheel(std::move(wheel)), m_id(id) {}
+
+    // Stops the timer. Returns false if it had already fired (one-shot) or been
+    // cancelled. A run that was already handed to the pool still goes ahead.
+    bool cancel() {
+        const std::shared_ptr<TimerWheel> wheel = m_wheel.lock();
+        return wheel && wheel->cancel(m_id);
+    }
+
+private:
+    std::weak_ptr<TimerWheel> m_wheel;
+    TimerWheel::Id m_id;
+};
+
+} // namespace util
@@ -0,0 +1,135 @@
+// unique_task.hpp
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <functional>  // For std::invoke
+#include <memory>      // For std::construct_at / std::destroy_at
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bytes reserved inside every task for the callable. Larger callables, or ones
+// whose move constructor may throw, are stored on the heap instead.
+// Configured from the Makefile.
+#ifndef FNGO_TASK_INLINE_SIZE
+#define FNGO_TASK_INLINE_SIZE 128
+#endif
+
+namespace util {
+
+/**
+ * @class basic_unique_task
+ * @brief A move-only `void()` callable with a small-buffer optimization.
+ *
+ * Unlike std::function it accepts move-only callables (for example lambdas that
+ * capture a std::unique_ptr), and it never allocates for callables that fit in
+ * InlineSize bytes. Type erasure uses one pointer to a static table of functions.
+ * A moved-from or default-constructed task is empty.
+ *
+ * @tparam InlineSize Size of the inline buffer, in bytes.
+ */
+template<std::size_t InlineSize>
+class basic_unique_task {
+public:
+    // True when F is stored in the inline buffer rather than on the heap.
+    template<typename F>
+    static constexpr bool stores_inline = sizeof(F) <= InlineSize
+        && alignof(F) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible_v<F>;
+
+    basic_unique_task() noexcept = default;
+
+    template<typename F>
+        requires (!std::same_as<std::remove_cvref_t<F>, basic_unique_task>)
+              && std::invocable<std::decay_t<F>&>
+    basic_unique_task(F&& callable) { // Implicit, like std::function.
+        using Fn = std::decay_t<F>;
+        if constexpr (stores_inline<Fn>) {
+            std::construct_at(reinterpret_cast<Fn*>(m_storage), std::forward<F>(callable));
+            m_ops = &inline_ops<Fn>;
+        } else {
+            *reinterpret_cast<Fn**>(m_storage) = new Fn(std::forward<F>(callable));
+            m_ops = &heap_ops<Fn>;
+        }
+    }
+
+    basic_unique_task(basic_unique_task&& other) noexcept
+        : m_ops(other.m_ops), m_continuation(std::exchange(other.m_continuation, false)) {
+        if (m_ops) {
+            m_ops->relocate(m_storage, other.m_storage);
+            other.m_ops = nullptr;
+        }
+    }
+
+    basic_unique_task& operator=(basic_unique_task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.m_ops) {
+                other.m_ops->relocate(m_storage, other.m_storage);
+                m_ops = other.m_ops;
+                other.m_ops = nullptr;
+            }
+            m_continuation = std::exchange(other.m_continuation, false);
+        }
+        return *this;
+    }
+
+    basic_unique_task(const basic_unique_task&) = delete;
+    basic_unique_task& operator=(const basic_unique_task&) = delete;
+
+    ~basic_unique_task() { reset(); }
+
+    void operator()() { m_ops->invoke(m_storage); }
+
+    explicit operator bool() const noexcept { return m_ops != nullptr; }
+
+    // Marks the task as the continuation of work a ThreadPool has already
+    // accepted, which the pool must not shed to make room for new tasks. The
+    // mark moves with the callable.
+    void mark_continuation() noexcept { m_continuation = true; }
+    bool is_continuation() const noexcept { return m_continuation; }
+
+    void reset() noexcept {
+        if (m_ops) {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+        m_continuation = false;
+    }
+
+private:
+    struct Operations {
+        void (*invoke)(std::byte* storage);
+        // Move-constructs into dst and destroys the source.
+        void (*relocate)(std::byte* dst, std::byte* src) noexcept;
+        void (*destroy)(std::byte* storage) noexcept;
+    };
+
+    template<typename Fn>
+    static constexpr Operations inline_ops{
+        [](std::byte* storage) { std::invoke(*std::launder(reinterpret_cast<Fn*>(storage))); },
+        [](std::byte* dst, std::byte* src) noexcept {
+            Fn* source = std::launder(reinterpret_cast<Fn*>(src));
+            std::construct_at(reinterpret_cast<Fn*>(dst), std::move(*source));
+            std::destroy_at(source);
+        },
+        [](std::byte* storage) noexcept { std::destroy_at(std::launder(reinterpret_cast<Fn*>(storage))); }
+    };
+
+    template<typename Fn>
+    static constexpr Operations heap_ops{
+        [](std::byte* storage) { std::invoke(**reinterpret_cast<Fn**>(storage)); },
+        [](std::byte* dst, std::byte* src) noexcept { *reinterpret_cast<Fn**>(dst) = *reinterpret_cast<Fn**>(src); },
+        [](std::byte* storage) noexcept { delete *reinterpret_cast<Fn**>(storage); }
+    };
+
+    alignas(std::max_align_t) std::byte m_storage[InlineSize < sizeof(void*) ? sizeof(void*) : InlineSize];
+    const Operations* m_ops = nullptr;
+    bool m_continuation = false; // Fits in the padding after m_ops.
+};
+
+// The task type stored by ThreadPool.
+using unique_task = basic_unique_task<FNGO_TASK_INLINE_SIZE>;
+
+} // namespace util
@@ -0,0 +1,139 @@
+// work_stealing_deque.hpp
+#pragma once
+
+#include "cache_line.hpp"
+#include <atomic>
+#include <bit>         // For std::bit_ceil
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+
+/**
+ * @class WorkStealingDeque
+ * @brief A lock-free Chase-Lev work-stealing deque.
+ *
+ * The owning worker pushes and pops at the bottom (LIFO, cache-warm), while any
+ * other thread may steal from the top (FIFO). The ring buffer grows on demand.
+ * Buffers replaced by a grow are retired, not freed, because a thief may still be
+ * reading from them; they are released together with the deque.
+ *
+ * Memory orderings follow Lê et al., "Correct and Efficient Work-Stealing for
+ * Weak Memory Models" (PPoPP 2013).
+ *
+ * @tparam T A trivially copyable element type (the pool stores task pointers).
+ * @note This class is an internal implementation detail.
+ */
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(std::size_t initial_capacity = 256)
+    {
+        const auto capacity = static_cast<std::int64_t>(std::bit_ceil(initial_capacity < 2 ? 2 : initial_capacity));
+        m_buffer.store(m_retired.emplace_back(std::make_unique<Buffer>(capacity)).get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+    WorkStealingDeque(WorkStealingDeque&&) = delete;
+    WorkStealingDeque& operator=(WorkStealingDeque&&) = delete;
+    ~WorkStealingDeque() = default;
+
+    // Owner only: adds an item at the bottom, growing the buffer if it is full.
+    void push(T item) {
+        const std::int64_t b = m_bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = m_top.load(std::memory_order_acquire);
+        Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+        if (b - t > buffer->capacity - 1) {
+            buffer = grow(buffer, b, t);
+        }
+        buffer->store(b, item);
+        m_bottom.store(b + 1, std::memory_order_release); // Publishes the item to thieves.
+    }
+
+    // Owner only: removes the most recently pushed item.
+    std::optional<T> pop() {
+        const std::int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) { // Already empty.
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        T item = buffer->load(b);
+        if (t == b) {
+            // Last item: race against thieves for it.
+            const bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won) {
+                return std::nullopt;
+            }
+        }
+        return item;
+    }
+
+    // Any thread: removes the oldest item. Returns nullopt when empty or when
+    // another thread won the race for the same item.
+    std::optional<T> steal() {
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return std::nullopt;
+        }
+
+        const Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+        T item = buffer->load(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return item;
+    }
+
+    // Any thread: an approximate item count, exact when called by the owner.
+    std::size_t size() const noexcept {
+        const std::int64_t b = m_bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<std::size_t>(b - t) : 0;
+    }
+
+    bool empty() const noexcept { return size() == 0; }
+
+private:
+    struct Buffer {
+        explicit Buffer(std::int64_t cap)
+            : capacity(cap), mask(cap - 1), slots(std::make_unique<std::atomic<T>[]>(static_cast<std::size_t>(cap))) {}
+
+        T load(std::int64_t i) const noexcept { return slots[i & mask].load(std::memory_order_relaxed); }
+        void store(std::int64_t i, T item) noexcept { slots[i & mask].store(item, std::memory_order_relaxed); }
+
+        std::int64_t capacity;
+        std::int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    Buffer* grow(const Buffer* old_buffer, std::int64_t bottom, std::int64_t top) {
+        Buffer* bigger = m_retired.emplace_back(std::make_unique<Buffer>(old_buffer->capacity * 2)).get();
+        for (std::int64_t i = top; i < bottom; ++i) {
+            bigger->store(i, old_buffer->load(i));
+        }
+        m_buffer.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    alignas(cache_line_size) std::atomic<std::int64_t> m_top{0};
+    alignas(cache_line_size) std::atomic<std::int64_t> m_bottom{0};
+    alignas(cache_line_size) std::atomic<Buffer*> m_buffer{nullptr};
+    std::vector<std::unique_ptr<Buffer>> m_retired; // Owns every buffer ever used, including the current one.
+};
+
+} // namespace util